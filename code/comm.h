@@ -9,11 +9,183 @@ typedef struct _COPY_MEMORY {
     size_t size;
 } COPY_MEMORY, *PCOPY_MEMORY;
 
+#define SMALL_READ_MAX 16
+
+//小数据读取，结果直接放在参数结构体中返回
+typedef struct _SMALL_MEMORY {
+    pid_t pid;
+    uint32_t size;          // 1 ~ SMALL_READ_MAX 字节
+    uintptr_t addr;
+    uint32_t copied;        // 返回实际读取的字节数
+    uint8_t value[SMALL_READ_MAX];
+} SMALL_MEMORY, *PSMALL_MEMORY;
+
 typedef struct _MODULE_BASE {
     pid_t pid;
     char* name;
     uintptr_t base;
 } MODULE_BASE, *PMODULE_BASE;
+#define GATHER_MAX_FIELDS 32
+#define GATHER_MAX_COUNT 0x10000
+#define GATHER_MAX_SIZE 0x1000000
+
+typedef struct _GATHER_FIELD {
+    uint32_t offset;
+    uint32_t size;
+} GATHER_FIELD, *PGATHER_FIELD;
+
+typedef struct _GATHER_MEMORY {
+    pid_t pid;
+    uintptr_t base;         // stride 非 0 时为首元素地址，为 0 时为指针数组地址
+    uint32_t count;
+    uint32_t stride;
+    uint32_t field_count;
+    GATHER_FIELD* fields;
+    void* buffer;           // 按字段依次存放 count 个值(SoA)
+    uint8_t* valid;         // 每个元素一位，(count + 7) / 8 字节
+} GATHER_MEMORY, *PGATHER_MEMORY;
+
+#define WATCH_MAX_ENTRIES 64
+
+enum WATCH_CONDITION {
+    WATCH_CHANGED = 0,      // 与开始等待时的值不同，开始时不可读则与首次读到的值比较
+    WATCH_EQUAL = 1,
+    WATCH_NOT_EQUAL = 2,
+    WATCH_GREATER = 3,      // 无符号比较
+    WATCH_LESS = 4
+};
+
+typedef struct _WATCH_ENTRY {
+    uintptr_t addr;
+    uint32_t size;          // 1 ~ 8 字节
+    uint32_t condition;
+    uint64_t value;         // 比较值，返回时为当前值
+} WATCH_ENTRY, *PWATCH_ENTRY;
+
+typedef struct _WAIT_MEMORY {
+    pid_t pid;
+    WATCH_ENTRY* entries;
+    uint32_t count;
+    uint32_t timeout_ms;
+    uint32_t interval_us;   // 采样间隔，0 使用默认值
+    int32_t hit;            // 返回满足条件的条目下标，超时为 -1
+} WAIT_MEMORY, *PWAIT_MEMORY;
+
+#define PAGE_ATTR_PRESENT 0x01
+#define PAGE_ATTR_SWAPPED 0x02      // 已换出或正在迁移
+#define PAGE_ATTR_WRITE 0x04
+#define PAGE_ATTR_DIRTY 0x08
+#define PAGE_ATTR_HUGE_PMD 0x10     // 属于 PMD 级大页
+#define PAGE_ATTR_HUGE_PUD 0x20     // 属于 PUD 级大页
+#define QUERY_MAX_PAGES 0x100000
+
+typedef struct _QUERY_PAGES {
+    pid_t pid;
+    uintptr_t addr;
+    size_t size;
+    uint8_t* buffer;        // 每页一字节 PAGE_ATTR_*，从 addr 所在页开始
+} QUERY_PAGES, *PQUERY_PAGES;
+
+#define PROGRAM_MAX_INSNS 1024
+#define PROGRAM_MAX_STEPS 0x100000
+#define PROGRAM_MAX_OUTPUT 0x100000
+#define PROGRAM_MAX_BYTES 0x1000000
+#define PROGRAM_REGS 8
+#define PROG_NO_TARGET 0xFFFFFFFF
+
+enum PROGRAM_OPCODE {
+    PROG_EXIT = 0,          // 结束
+    PROG_LDI,               // r[dst] = imm
+    PROG_MOV,               // r[dst] = r[src]
+    PROG_ADD,               // r[dst] += r[src] + imm
+    PROG_ADDI,              // r[dst] += imm
+    PROG_READ,              // r[dst] = *(size 字节*)(r[src] + imm)，失败跳转 target
+    PROG_DEREF,             // r[dst] = *(uint64_t*)(r[src] + imm) 去除标签位，失败跳转 target
+    PROG_JEQ,               // r[dst] == r[src] 时跳转 target
+    PROG_JNE,
+    PROG_JLT,               // 无符号比较
+    PROG_JGE,
+    PROG_JEQI,              // r[dst] == imm 时跳转 target
+    PROG_JNEI,
+    PROG_LOOP,              // --r[dst] 不为 0 时跳转 target
+    PROG_EMIT,              // 输出 r[src] 的低 size 字节
+    PROG_EMITM,             // 输出 r[src] + imm 处的 size(1 ~ 255) 字节内存，失败时输出 0 并跳转 target
+    PROG_OP_MAX
+};
+
+enum PROGRAM_STATUS {
+    PROG_OK = 0,
+    PROG_FAULT,             // 读取失败且没有跳转目标
+    PROG_STEP_LIMIT,
+    PROG_BYTE_LIMIT,
+    PROG_OUTPUT_FULL
+};
+
+typedef struct _PROGRAM_INSN {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t src;
+    uint8_t size;
+    uint32_t target;        // 跳转目标指令下标，读取类指令为 PROG_NO_TARGET 时失败即结束
+    uint64_t imm;
+} PROGRAM_INSN, *PPROGRAM_INSN;
+
+typedef struct _PROGRAM_MEMORY {
+    pid_t pid;
+    PROGRAM_INSN* insns;
+    uint32_t insn_count;
+    uint32_t step_budget;   // 最多执行的指令数，0 使用上限
+    uint32_t byte_budget;   // 最多读取的字节数，0 使用上限
+    uint32_t output_size;
+    void* output;
+    uint64_t regs[PROGRAM_REGS];    // 初始寄存器，返回最终值
+    uint32_t status;
+    uint32_t output_used;
+    uint32_t steps;
+    uint32_t fault_pc;
+} PROGRAM_MEMORY, *PPROGRAM_MEMORY;
+
+#define PIN_MAX_ENTRIES 256
+#define PIN_MAX_VALUE 16
+
+typedef struct _PIN_ENTRY {
+    uintptr_t addr;
+    uint32_t size;          // 1 ~ PIN_MAX_VALUE 字节
+    uint32_t interval_ms;
+    uint8_t value[PIN_MAX_VALUE];
+    uint64_t hits;          // 写入成功次数
+    uint64_t misses;        // 页面不在内存等原因写入失败的次数
+} PIN_ENTRY, *PPIN_ENTRY;
+
+typedef struct _PIN_MEMORY {
+    pid_t pid;
+    PIN_ENTRY* entries;
+    uint32_t count;
+} PIN_MEMORY, *PPIN_MEMORY;
+
+#define EVENT_PATH_MAX 256
+
+enum EVENT_TYPE {
+    EVENT_EXIT = 1,         // 目标进程退出
+    EVENT_EXEC = 2,         // 目标进程执行了 exec
+    EVENT_MAP = 3,          // 新的文件映射，path 为文件路径
+    EVENT_UNMAP = 4         // 文件映射被移除
+};
+
+typedef struct _MEM_EVENT {
+    uint32_t type;
+    pid_t pid;
+    uintptr_t start;
+    uintptr_t end;
+    char path[EVENT_PATH_MAX];
+} MEM_EVENT, *PMEM_EVENT;
+
+typedef struct _EVENT_SUBSCRIBE {
+    pid_t pid;
+    char* pattern;          // 只报告路径包含该字符串的映射，NULL 为全部
+    uint32_t interval_ms;   // 内核采样间隔，0 使用默认值
+} EVENT_SUBSCRIBE, *PEVENT_SUBSCRIBE;
+
 struct process {
     pid_t process_pid;
 	char *process_comm;
@@ -26,7 +198,16 @@ enum OPERATIONS {
     OP_MODULE_BASE = 0x803,
     OP_HIDE_PROCESS = 0x804,
     OP_PID_HIDE_PROCESS = 0x805,
-    OP_GET_PROCESS_PID = 0x806
+    OP_GET_PROCESS_PID = 0x806,
+    OP_GATHER_MEM = 0x807,
+    OP_WAIT_MEM = 0x808,
+    OP_QUERY_PAGES = 0x809,
+    OP_RUN_PROGRAM = 0x80A,
+    OP_PIN_MEM = 0x80B,
+    OP_PIN_STATS = 0x80C,
+    OP_SET_TARGET = 0x80D,
+    OP_SUBSCRIBE_EVENTS = 0x80E,
+    OP_READ_SMALL = 0x80F
 };
 
 char* get_rand_str(void)
@@ -47,5 +228,10 @@ char* get_rand_str(void)
 	return string;
 }
 
+//每个打开的设备文件的状态
+struct mem_tool_file {
+    pid_t pid;              // OP_SET_TARGET 选择的目标进程，pread/pwrite 的偏移即目标虚拟地址
+};
+
 int dispatch_open(struct inode *node, struct file *file);
 int dispatch_close(struct inode *node, struct file *file);
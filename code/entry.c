@@ -6,6 +6,10 @@
 #include "memory.h"
 #include "process.h"
 #include "hide_process.h"
+#include "watch.h"
+#include "program.h"
+#include "pin.h"
+#include "events.h"
 //#include "verify.h"
 
 #if (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 3, 0))
@@ -27,7 +31,7 @@ const char *devicename;
 
 long dispatch_ioctl(struct file *const file, unsigned int const cmd, unsigned long const arg)
 {
-	static COPY_MEMORY cm;
+	COPY_MEMORY cm;
 	static MODULE_BASE mb;
 	static struct process p_process;
 	static char name[0x100] = {0};
@@ -60,6 +64,22 @@ long dispatch_ioctl(struct file *const file, unsigned int const cmd, unsigned lo
 			}
 			break;
 
+		case OP_READ_SMALL:
+			{
+				SMALL_MEMORY sm;
+
+				if (copy_from_user(&sm, (void __user*)arg, sizeof(sm)) != 0) {
+					return -1;
+				}
+				if (read_process_small(&sm) == false) {
+					return -1;
+				}
+				if (copy_to_user((void __user*)arg, &sm, sizeof(sm)) != 0) {
+					return -1;
+				}
+			}
+			break;
+
 		case OP_WRITE_MEM:
 			{
 				if (copy_from_user(&cm, (void __user*)arg, sizeof(cm)) != 0) {
@@ -71,6 +91,116 @@ long dispatch_ioctl(struct file *const file, unsigned int const cmd, unsigned lo
 			}
 			break;
 
+		case OP_GATHER_MEM:
+			{
+				GATHER_MEMORY gm;
+
+				if (copy_from_user(&gm, (void __user*)arg, sizeof(gm)) != 0) {
+					return -1;
+				}
+				if (gather_process_memory(&gm) == false) {
+					return -1;
+				}
+			}
+			break;
+
+		case OP_WAIT_MEM:
+			{
+				WAIT_MEMORY wm;
+				int ret;
+
+				if (copy_from_user(&wm, (void __user*)arg, sizeof(wm)) != 0) {
+					return -1;
+				}
+				ret = wait_process_memory(&wm);
+				if (ret != 0) {
+					return ret;
+				}
+				if (copy_to_user((void __user*)arg, &wm, sizeof(wm)) != 0) {
+					return -1;
+				}
+			}
+			break;
+
+		case OP_QUERY_PAGES:
+			{
+				QUERY_PAGES qp;
+
+				if (copy_from_user(&qp, (void __user*)arg, sizeof(qp)) != 0) {
+					return -1;
+				}
+				if (query_process_pages(&qp) == false) {
+					return -1;
+				}
+			}
+			break;
+
+		case OP_RUN_PROGRAM:
+			{
+				PROGRAM_MEMORY pm;
+
+				if (copy_from_user(&pm, (void __user*)arg, sizeof(pm)) != 0) {
+					return -1;
+				}
+				if (run_program(&pm) == false) {
+					return -1;
+				}
+				if (copy_to_user((void __user*)arg, &pm, sizeof(pm)) != 0) {
+					return -1;
+				}
+			}
+			break;
+
+		case OP_PIN_MEM:
+			{
+				PIN_MEMORY pm;
+
+				if (copy_from_user(&pm, (void __user*)arg, sizeof(pm)) != 0) {
+					return -1;
+				}
+				if (pin_process_memory(&pm) == false) {
+					return -1;
+				}
+			}
+			break;
+
+		case OP_PIN_STATS:
+			{
+				PIN_MEMORY pm;
+
+				if (copy_from_user(&pm, (void __user*)arg, sizeof(pm)) != 0) {
+					return -1;
+				}
+				if (pin_process_stats(&pm) == false) {
+					return -1;
+				}
+				if (copy_to_user((void __user*)arg, &pm, sizeof(pm)) != 0) {
+					return -1;
+				}
+			}
+			break;
+
+		case OP_SET_TARGET:
+			{
+				struct mem_tool_file *mf = file->private_data;
+
+				if (copy_from_user(&mf->pid, (void __user*)arg, sizeof(mf->pid)) != 0) {
+					return -1;
+				}
+			}
+			break;
+
+		case OP_SUBSCRIBE_EVENTS:
+			{
+				EVENT_SUBSCRIBE sub;
+
+				if (copy_from_user(&sub, (void __user*)arg, sizeof(sub)) != 0) {
+					return -1;
+				}
+				//返回事件流的文件描述符
+				return subscribe_events(&sub);
+			}
+
 		case OP_MODULE_BASE:
 			{
 				if (copy_from_user(&mb, (void __user*)arg, sizeof(mb)) != 0 
@@ -115,8 +245,16 @@ const char *devicename;
 struct task_struct *task;
 int dispatch_open(struct inode *node, struct file *file)
 {
+	struct mem_tool_file *mf;
+
+	mf = kzalloc(sizeof(*mf), GFP_KERNEL);
+	if (!mf) {
+		return -ENOMEM;
+	}
+	file->private_data = mf;
+	//偏移为目标虚拟地址，允许超过 LLONG_MAX
+	file->f_mode |= FMODE_UNSIGNED_OFFSET;
 	//获取连接驱动进程的pid
-	file->private_data = &memdev;
 	task = current;  // 获取当前进程的task_struct
 	printk("隐藏进程成功pid:%d\n", task->pid);
 	
@@ -131,14 +269,48 @@ int dispatch_close(struct inode *node, struct file *file)
 	if (hide_process_pid != 0) {
 		recover_process(hide_pid_process_task);
 	}
+	kfree(file->private_data);
     return 0;
 }
 
+ssize_t dispatch_read_iter(struct kiocb *iocb, struct iov_iter *to)
+{
+	struct mem_tool_file *mf = iocb->ki_filp->private_data;
+	ssize_t ret;
+
+	if (mf->pid == 0) {
+		return -EINVAL;
+	}
+	ret = process_memory_iter(mf->pid, (uintptr_t)iocb->ki_pos, to, false);
+	if (ret > 0) {
+		iocb->ki_pos += ret;
+	}
+	return ret;
+}
+
+ssize_t dispatch_write_iter(struct kiocb *iocb, struct iov_iter *from)
+{
+	struct mem_tool_file *mf = iocb->ki_filp->private_data;
+	ssize_t ret;
+
+	if (mf->pid == 0) {
+		return -EINVAL;
+	}
+	ret = process_memory_iter(mf->pid, (uintptr_t)iocb->ki_pos, from, true);
+	if (ret > 0) {
+		iocb->ki_pos += ret;
+	}
+	return ret;
+}
+
 struct file_operations dispatch_functions = {
     .owner = THIS_MODULE,
     .open = dispatch_open,
     .release = dispatch_close,
     .unlocked_ioctl = dispatch_ioctl,
+    .read_iter = dispatch_read_iter,
+    .write_iter = dispatch_write_iter,
+    .llseek = default_llseek,
 };
 
 static int __init driver_entry(void) {
@@ -183,6 +355,7 @@ static int __init driver_entry(void) {
 }
 
 static void __exit driver_unload(void) {
+    pin_release_all();
     device_destroy(mem_tool_class, mem_tool_dev_t);
     class_destroy(mem_tool_class);
     cdev_del(&memdev.cdev);
@@ -0,0 +1,355 @@
+#include <linux/version.h>
+#include <linux/sched.h>
+#include <linux/mm.h>
+#include <linux/pid.h>
+#include <linux/poll.h>
+#include <linux/wait.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+#include <linux/anon_inodes.h>
+#include <linux/file.h>
+#include <linux/fs.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+#define EVENT_QUEUE_SIZE 256
+#define EVENT_DEFAULT_INTERVAL_MS 20
+
+#if(LINUX_VERSION_CODE < KERNEL_VERSION(5, 8, 0))
+#define mmap_read_lock(mm) down_read(&(mm)->mmap_sem)
+#define mmap_read_unlock(mm) up_read(&(mm)->mmap_sem)
+#endif
+
+//按 dev/inode/pgoff 识别映射，文件对象地址会被复用
+struct vma_record {
+	uintptr_t start;
+	uintptr_t end;
+	dev_t dev;
+	unsigned long ino;
+	unsigned long pgoff;
+	struct file* file;      //仅在持有 mmap 锁的采样期间有效
+	bool matched;
+};
+
+//订阅状态：内核定时采样目标进程，与上次快照比较后生成事件
+struct event_stream {
+	struct delayed_work work;
+	struct pid* pid;
+	pid_t nr;
+	char pattern[EVENT_PATH_MAX];
+	unsigned long interval;
+	u64 exec_id;
+	bool started;
+	bool exited;
+	struct vma_record* vmas;
+	struct vma_record* next_vmas;
+	int nr_vmas;
+	int capacity;
+	char* path_buf;
+	spinlock_t lock;
+	MEM_EVENT* queue;
+	unsigned int head;
+	unsigned int tail;
+	wait_queue_head_t wait;
+};
+
+//队列满时丢弃最旧的事件
+void event_push(struct event_stream* es, uint32_t type, uintptr_t start, uintptr_t end, const char* path)
+{
+	MEM_EVENT* ev;
+
+	spin_lock(&es->lock);
+	if (es->head - es->tail == EVENT_QUEUE_SIZE) {
+		es->tail++;
+	}
+	ev = &es->queue[es->head % EVENT_QUEUE_SIZE];
+	ev->type = type;
+	ev->pid = es->nr;
+	ev->start = start;
+	ev->end = end;
+	strscpy(ev->path, path ? path : "", sizeof(ev->path));
+	es->head++;
+	spin_unlock(&es->lock);
+	wake_up_interruptible(&es->wait);
+}
+
+bool event_match(struct event_stream* es, struct vma_record* v, char** path)
+{
+	*path = d_path(&v->file->f_path, es->path_buf, ARC_PATH_MAX - 1);
+	if (IS_ERR(*path)) {
+		*path = NULL;
+		return false;
+	}
+	return es->pattern[0] == 0 || strstr(*path, es->pattern) != NULL;
+}
+
+//扩容快照数组，保留上次快照
+int event_reserve(struct event_stream* es, int capacity)
+{
+	struct vma_record* vmas = kvmalloc_array(capacity, sizeof(*vmas), GFP_KERNEL);
+	struct vma_record* next_vmas = kvmalloc_array(capacity, sizeof(*next_vmas), GFP_KERNEL);
+
+	if (!vmas || !next_vmas) {
+		kvfree(vmas);
+		kvfree(next_vmas);
+		return -1;
+	}
+	if (es->nr_vmas) {
+		memcpy(vmas, es->vmas, es->nr_vmas * sizeof(*vmas));
+	}
+	kvfree(es->vmas);
+	kvfree(es->next_vmas);
+	es->vmas = vmas;
+	es->next_vmas = next_vmas;
+	es->capacity = capacity;
+	return 0;
+}
+
+//收集文件映射，按起始地址有序；调用时需持有 mmap 读锁且容量不小于 map_count
+int event_snapshot(struct event_stream* es, struct mm_struct* mm)
+{
+	struct vm_area_struct* vma;
+	int n = 0;
+
+	vma = find_vma(mm, 0);
+	while (vma) {
+		if (vma->vm_file) {
+			struct inode* inode = file_inode(vma->vm_file);
+
+			if (n >= es->capacity) {
+				return -1;
+			}
+			es->next_vmas[n].start = vma->vm_start;
+			es->next_vmas[n].end = vma->vm_end;
+			es->next_vmas[n].dev = inode->i_sb->s_dev;
+			es->next_vmas[n].ino = inode->i_ino;
+			es->next_vmas[n].pgoff = vma->vm_pgoff;
+			es->next_vmas[n].file = vma->vm_file;
+			es->next_vmas[n].matched = false;
+			n++;
+		}
+		if (vma->vm_end >= ULONG_MAX) break;
+		vma = find_vma(mm, vma->vm_end);
+	}
+	return n;
+}
+
+//与上次快照比较，新映射在此处取路径，调用时需持有 mmap 读锁
+void event_diff(struct event_stream* es, int n)
+{
+	struct vma_record* old = es->vmas;
+	struct vma_record* cur = es->next_vmas;
+	struct vma_record* tmp;
+	char* path;
+	int i = 0, j = 0;
+
+	while (i < es->nr_vmas || j < n) {
+		if (i < es->nr_vmas && j < n && old[i].start == cur[j].start
+		&& old[i].end == cur[j].end && old[i].dev == cur[j].dev
+		&& old[i].ino == cur[j].ino && old[i].pgoff == cur[j].pgoff) {
+			cur[j++].matched = old[i++].matched;
+		} else if (i < es->nr_vmas && (j >= n || old[i].start <= cur[j].start)) {
+			if (old[i].matched) {
+				event_push(es, EVENT_UNMAP, old[i].start, old[i].end, NULL);
+			}
+			i++;
+		} else {
+			cur[j].matched = event_match(es, &cur[j], &path);
+			if (cur[j].matched) {
+				event_push(es, EVENT_MAP, cur[j].start, cur[j].end, path);
+			}
+			j++;
+		}
+	}
+	tmp = es->vmas;
+	es->vmas = es->next_vmas;
+	es->next_vmas = tmp;
+	es->nr_vmas = n;
+}
+
+void event_sample(struct work_struct* work)
+{
+	struct event_stream* es = container_of(to_delayed_work(work), struct event_stream, work);
+	struct task_struct* task;
+	struct mm_struct* mm = NULL;
+	u64 exec_id = 0;
+	int n, count;
+
+	rcu_read_lock();
+	task = pid_task(es->pid, PIDTYPE_PID);
+	if (task) {
+		exec_id = task->self_exec_id;
+		mm = get_task_mm(task);
+	}
+	rcu_read_unlock();
+	if (!mm) {
+		//目标进程退出后停止采样，EVENT_EXIT 入队后再标记，读取方取完队列才会看到结束
+		event_push(es, EVENT_EXIT, 0, 0, NULL);
+		spin_lock(&es->lock);
+		es->exited = true;
+		spin_unlock(&es->lock);
+		wake_up_interruptible(&es->wait);
+		return;
+	}
+	if (es->started && exec_id != es->exec_id) {
+		event_push(es, EVENT_EXEC, 0, 0, NULL);
+		es->nr_vmas = 0;
+	}
+	es->exec_id = exec_id;
+	es->started = true;
+
+	//map_count 只在持锁时可信，容量不足时解锁扩容后重试，不截断快照
+	for (;;) {
+		mmap_read_lock(mm);
+		if (mm->map_count <= es->capacity) {
+			break;
+		}
+		count = mm->map_count;
+		mmap_read_unlock(mm);
+		if (event_reserve(es, count + 64) < 0) {
+			goto out;
+		}
+	}
+	n = event_snapshot(es, mm);
+	if (n >= 0) {
+		event_diff(es, n);
+	}
+	mmap_read_unlock(mm);
+out:
+	mmput(mm);
+	queue_delayed_work(system_wq, &es->work, es->interval);
+}
+
+//队列非空或采样已结束时返回 true
+bool event_ready(struct event_stream* es)
+{
+	bool ready;
+
+	spin_lock(&es->lock);
+	ready = es->head != es->tail || es->exited;
+	spin_unlock(&es->lock);
+	return ready;
+}
+
+//目标进程退出且队列取完后返回 0
+ssize_t event_read(struct file* file, char __user* buf, size_t count, loff_t* ppos)
+{
+	struct event_stream* es = file->private_data;
+	MEM_EVENT ev;
+	ssize_t done = 0;
+	int ret;
+
+	if (count < sizeof(MEM_EVENT)) {
+		return -EINVAL;
+	}
+	if (!event_ready(es)) {
+		if (file->f_flags & O_NONBLOCK) {
+			return -EAGAIN;
+		}
+		ret = wait_event_interruptible(es->wait, event_ready(es));
+		if (ret) {
+			return ret;
+		}
+	}
+	while (count - done >= sizeof(MEM_EVENT)) {
+		spin_lock(&es->lock);
+		if (es->head == es->tail) {
+			spin_unlock(&es->lock);
+			break;
+		}
+		ev = es->queue[es->tail % EVENT_QUEUE_SIZE];
+		es->tail++;
+		spin_unlock(&es->lock);
+		if (copy_to_user(buf + done, &ev, sizeof(ev)) != 0) {
+			return done ? done : -EFAULT;
+		}
+		done += sizeof(ev);
+	}
+	return done;
+}
+
+unsigned int event_poll(struct file* file, poll_table* wait)
+{
+	struct event_stream* es = file->private_data;
+	unsigned int mask = 0;
+
+	poll_wait(file, &es->wait, wait);
+	spin_lock(&es->lock);
+	if (es->head != es->tail) {
+		mask = POLLIN | POLLRDNORM;
+	} else if (es->exited) {
+		mask = POLLHUP;
+	}
+	spin_unlock(&es->lock);
+	return mask;
+}
+
+int event_release(struct inode* node, struct file* file)
+{
+	struct event_stream* es = file->private_data;
+
+	cancel_delayed_work_sync(&es->work);
+	put_pid(es->pid);
+	kvfree(es->vmas);
+	kvfree(es->next_vmas);
+	kfree(es->path_buf);
+	kfree(es->queue);
+	kfree(es);
+	return 0;
+}
+
+struct file_operations event_functions = {
+	.owner = THIS_MODULE,
+	.read = event_read,
+	.poll = event_poll,
+	.release = event_release,
+	.llseek = noop_llseek,
+};
+
+//创建事件流并返回新的文件描述符，首次采样时已有的匹配映射也会产生 EVENT_MAP
+int subscribe_events(PEVENT_SUBSCRIBE sub)
+{
+	struct event_stream* es;
+	int fd;
+
+	es = kzalloc(sizeof(*es), GFP_KERNEL);
+	if (!es) {
+		return -ENOMEM;
+	}
+	es->queue = kcalloc(EVENT_QUEUE_SIZE, sizeof(MEM_EVENT), GFP_KERNEL);
+	es->path_buf = kmalloc(ARC_PATH_MAX, GFP_KERNEL);
+	es->pid = find_get_pid(sub->pid);
+	if (!es->queue || !es->path_buf || !es->pid) {
+		goto fail;
+	}
+	if (sub->pattern && strncpy_from_user(es->pattern, (void __user*)sub->pattern, sizeof(es->pattern) - 1) < 0) {
+		goto fail;
+	}
+	es->nr = sub->pid;
+	es->interval = msecs_to_jiffies(sub->interval_ms ? sub->interval_ms : EVENT_DEFAULT_INTERVAL_MS);
+	spin_lock_init(&es->lock);
+	init_waitqueue_head(&es->wait);
+	INIT_DELAYED_WORK(&es->work, event_sample);
+
+	//先启动采样，描述符安装后随时可能被关闭并释放 es
+	queue_delayed_work(system_wq, &es->work, 0);
+	fd = anon_inode_getfd("[mem_events]", &event_functions, es, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		cancel_delayed_work_sync(&es->work);
+		put_pid(es->pid);
+		kvfree(es->vmas);
+		kvfree(es->next_vmas);
+		kfree(es->path_buf);
+		kfree(es->queue);
+		kfree(es);
+		return fd;
+	}
+	return fd;
+
+fail:
+	put_pid(es->pid);
+	kfree(es->path_buf);
+	kfree(es->queue);
+	kfree(es);
+	return -EINVAL;
+}
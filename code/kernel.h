@@ -9,6 +9,528 @@
 #include <sys/fcntl.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
+#include <sys/uio.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <functional>
+#include <condition_variable>
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
+
+// 读取轨迹文件格式：
+//   头部 "DRVTRACE" + uint32 版本号
+//   每条记录：varint (size << 3 | kind << 2 | same << 1 | ok)
+//             zigzag varint 地址差值(相对上一条记录)
+//             varint 时间差值(纳秒)
+//             数据(ok 且 same 为 0 时为 size 字节)
+//   same 表示数据与该地址上一次读取的结果相同；kind 为 1 时记录模块基址查询，数据为模块名，地址为基址
+class c_trace_recorder {
+	private:
+	FILE *fp = NULL;
+	std::mutex lock;
+	uintptr_t last_addr = 0;
+	uint64_t last_time = 0;
+	// 只对小读取去重，大块读取总是写入数据，避免缓存整块内存
+	static const size_t SAME_MAX_SIZE = 64;
+	static const size_t SAME_MAX_ENTRIES = 0x10000;
+	std::unordered_map<uintptr_t, std::string> last_data;
+
+	static uint64_t now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
+
+	void put_varint(uint64_t v) {
+		uint8_t buf[10];
+		int n = 0;
+		while (v >= 0x80) {
+			buf[n++] = (uint8_t)(v | 0x80);
+			v >>= 7;
+		}
+		buf[n++] = (uint8_t)v;
+		fwrite(buf, 1, n, fp);
+	}
+
+	void put_header(uint64_t size, int kind, bool same, bool ok, uintptr_t addr) {
+		int64_t delta = (int64_t)(addr - last_addr);
+		uint64_t t = now();
+		put_varint(size << 3 | kind << 2 | same << 1 | ok);
+		put_varint((uint64_t)(delta << 1) ^ (uint64_t)(delta >> 63));
+		put_varint(last_time ? t - last_time : 0);
+		last_addr = addr;
+		last_time = t;
+	}
+
+	public:
+	~c_trace_recorder() {
+		close();
+	}
+
+	bool open(const char *path) {
+		fp = fopen(path, "wb");
+		if (fp == NULL)
+			return false;
+		fwrite("DRVTRACE", 1, 8, fp);
+		uint32_t version = 1;
+		fwrite(&version, sizeof(version), 1, fp);
+		return true;
+	}
+
+	void close() {
+		std::lock_guard<std::mutex> lk(lock);
+		if (fp != NULL)
+			fclose(fp);
+		fp = NULL;
+	}
+
+	void record_read(uintptr_t addr, const void *buffer, size_t size, bool ok) {
+		std::lock_guard<std::mutex> lk(lock);
+		if (fp == NULL)
+			return;
+		bool same = false;
+		if (ok && size > SAME_MAX_SIZE) {
+			last_data.erase(addr);
+		} else if (ok) {
+			if (last_data.size() >= SAME_MAX_ENTRIES && last_data.find(addr) == last_data.end())
+				last_data.clear();
+			std::string &last = last_data[addr];
+			same = last.size() == size && memcmp(last.data(), buffer, size) == 0;
+			if (!same)
+				last.assign((const char *)buffer, size);
+		}
+		put_header(size, 0, same, ok, addr);
+		if (ok && !same)
+			fwrite(buffer, 1, size, fp);
+	}
+
+	void record_module_base(const char *name, uintptr_t base) {
+		std::lock_guard<std::mutex> lk(lock);
+		if (fp == NULL)
+			return;
+		size_t size = strlen(name);
+		put_header(size, 1, false, true, base);
+		fwrite(name, 1, size, fp);
+	}
+};
+
+// 按录制顺序回放读取结果；请求与下一条记录不一致时按地址查找之后最近的一次读取并跳到该位置
+class c_trace_replayer {
+	private:
+	struct record {
+		uintptr_t addr;
+		size_t size;
+		size_t data;
+		uint64_t time;
+		bool ok;
+	};
+
+	std::mutex lock;
+	std::vector<uint8_t> blob;
+	std::vector<record> records;
+	std::unordered_map<uintptr_t, std::vector<size_t>> by_addr;
+	std::unordered_map<std::string, uintptr_t> module_bases;
+	size_t cursor = 0;
+
+	static bool get_varint(const uint8_t *&p, const uint8_t *end, uint64_t &v) {
+		v = 0;
+		for (int shift = 0; p < end && shift < 64; shift += 7) {
+			uint8_t b = *p++;
+			v |= (uint64_t)(b & 0x7f) << shift;
+			if (!(b & 0x80))
+				return true;
+		}
+		return false;
+	}
+
+	bool serve(size_t index, void *buffer, size_t size) {
+		const record &r = records[index];
+		if (r.ok)
+			memcpy(buffer, blob.data() + r.data, size);
+		return r.ok;
+	}
+
+	public:
+	bool open(const char *path) {
+		FILE *fp = fopen(path, "rb");
+		if (fp == NULL)
+			return false;
+		std::vector<uint8_t> file;
+		uint8_t buf[0x10000];
+		size_t n;
+		while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+			file.insert(file.end(), buf, buf + n);
+		fclose(fp);
+		if (file.size() < 12 || memcmp(file.data(), "DRVTRACE", 8) != 0)
+			return false;
+
+		const uint8_t *p = file.data() + 12;
+		const uint8_t *end = file.data() + file.size();
+		std::unordered_map<uintptr_t, size_t> last_data;
+		uintptr_t addr = 0;
+		uint64_t time = 0;
+		blob.reserve(file.size());
+		while (p < end) {
+			uint64_t head, delta, dt;
+			if (!get_varint(p, end, head) || !get_varint(p, end, delta) || !get_varint(p, end, dt))
+				return false;
+			addr += (uintptr_t)((delta >> 1) ^ (0 - (delta & 1)));
+			time += dt;
+			size_t size = head >> 3;
+			bool ok = head & 1;
+			bool same = head & 2;
+			if ((head & 4) != 0) {
+				if ((size_t)(end - p) < size)
+					return false;
+				module_bases[std::string((const char *)p, size)] = addr;
+				p += size;
+				continue;
+			}
+			record r = {addr, size, blob.size(), time, ok};
+			if (ok && same) {
+				// 引用的数据必须已出现过且足够长
+				auto it = last_data.find(addr);
+				if (it == last_data.end())
+					return false;
+				r.data = it->second;
+				if (r.data + size > blob.size())
+					return false;
+			} else if (ok) {
+				if ((size_t)(end - p) < size)
+					return false;
+				blob.insert(blob.end(), p, p + size);
+				p += size;
+				last_data[addr] = r.data;
+			}
+			by_addr[addr].push_back(records.size());
+			records.push_back(r);
+		}
+		return true;
+	}
+
+	bool read(uintptr_t addr, void *buffer, size_t size) {
+		std::lock_guard<std::mutex> lk(lock);
+		if (cursor < records.size() && records[cursor].addr == addr && records[cursor].size == size)
+			return serve(cursor++, buffer, size);
+
+		auto it = by_addr.find(addr);
+		if (it != by_addr.end()) {
+			const std::vector<size_t> &list = it->second;
+			// 优先取当前位置之后的第一条，没有时取之前的最后一条
+			size_t found = records.size();
+			for (size_t index : list) {
+				if (records[index].size < size)
+					continue;
+				found = index;
+				if (index >= cursor)
+					break;
+			}
+			if (found != records.size()) {
+				//跳过了部分记录时向前追赶，避免停在同一位置
+				if (found >= cursor)
+					cursor = found + 1;
+				return serve(found, buffer, size);
+			}
+		}
+		memset(buffer, 0, size);
+		return false;
+	}
+
+	uintptr_t module_base(const char *name) {
+		std::lock_guard<std::mutex> lk(lock);
+		auto it = module_bases.find(name);
+		return it == module_bases.end() ? 0 : it->second;
+	}
+
+	void rewind() {
+		std::lock_guard<std::mutex> lk(lock);
+		cursor = 0;
+	}
+
+	size_t size() const {
+		return records.size();
+	}
+
+	// 录制时长(纳秒)
+	uint64_t duration() const {
+		return records.empty() ? 0 : records.back().time - records.front().time;
+	}
+};
+
+// 调用点统计：编译时定义 DRIVER_PROFILE(需要 C++20)后，read/write/get_module_base 按调用位置记录次数、字节数和耗时
+// 封装读取的辅助函数(UE4 容器、名称缓存、合并读取、指针扫描)把调用者的位置继续传给 read，统计记在调用者处
+// 每个线程独立记录，无锁；未定义时所有统计代码不参与编译
+#ifdef DRIVER_PROFILE
+#include <source_location>
+#define DRIVER_PROFILE_LOC , std::source_location loc = std::source_location::current()
+#define DRIVER_PROFILE_ARG , loc
+#define DRIVER_PROFILE_LOC_ONLY std::source_location loc = std::source_location::current()
+#define DRIVER_PROFILE_ARG_ONLY loc
+#define DRIVER_PROFILE_SCOPE(op, size) c_profile_scope profile_scope(op, size, loc)
+
+enum PROFILE_OP {
+	PROFILE_READ,
+	PROFILE_WRITE,
+	PROFILE_MODULE_BASE,
+};
+
+class c_profiler {
+	public:
+	static const int BUCKETS = 40;	// 按耗时(纳秒)的 log2 分桶
+	static const int SLOTS = 512;
+	static const int EVENTS = 8192;
+
+	private:
+	struct site {
+		std::atomic<const char *> file;
+		const char *function;
+		uint32_t line;
+		uint32_t op;
+		std::atomic<uint64_t> count;
+		std::atomic<uint64_t> bytes;
+		std::atomic<uint64_t> total_ns;
+		std::atomic<uint64_t> max_ns;
+		std::atomic<uint64_t> buckets[BUCKETS];
+	};
+
+	struct event {
+		uint64_t start_ns;
+		uint32_t dur_ns;
+		uint32_t bytes;
+		uint32_t site;
+		uint32_t tid;
+	};
+
+	// 只由所属线程写入，报告时其他线程只读；线程退出后保留统计并交给新线程继续使用
+	struct thread_data {
+		site sites[SLOTS];
+		event events[EVENTS];
+		std::atomic<uint64_t> event_head;
+		std::atomic<bool> in_use;
+		uint32_t tid;
+	};
+
+	struct thread_owner {
+		thread_data *data = NULL;
+		~thread_owner() {
+			if (data != NULL)
+				data->in_use.store(false, std::memory_order_release);
+		}
+	};
+
+	static std::mutex &registry_lock() {
+		static std::mutex lock;
+		return lock;
+	}
+
+	static std::vector<thread_data *> &registry() {
+		static std::vector<thread_data *> threads;
+		return threads;
+	}
+
+	static thread_data *local() {
+		static thread_local thread_owner owner;
+		if (owner.data == NULL) {
+			std::lock_guard<std::mutex> lk(registry_lock());
+			for (thread_data *t : registry()) {
+				bool expected = false;
+				if (t->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+					owner.data = t;
+					break;
+				}
+			}
+			if (owner.data == NULL) {
+				owner.data = new thread_data();
+				owner.data->in_use.store(true, std::memory_order_relaxed);
+				registry().push_back(owner.data);
+			}
+			owner.data->tid = gettid();
+		}
+		return owner.data;
+	}
+
+	static void add(std::atomic<uint64_t> &counter, uint64_t v) {
+		counter.store(counter.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+	}
+
+	static const char *op_name(uint32_t op) {
+		switch (op) {
+			case PROFILE_READ: return "read";
+			case PROFILE_WRITE: return "write";
+			case PROFILE_MODULE_BASE: return "module_base";
+			default: return "?";
+		}
+	}
+
+	struct summary {
+		const char *file;
+		const char *function;
+		uint32_t line;
+		uint32_t op;
+		uint64_t count;
+		uint64_t bytes;
+		uint64_t total_ns;
+		uint64_t max_ns;
+		uint64_t buckets[BUCKETS];
+	};
+
+	static uint64_t percentile(const summary &s, double p) {
+		uint64_t want = (uint64_t)(s.count * p);
+		uint64_t seen = 0;
+		for (int b = 0; b < BUCKETS; b++) {
+			seen += s.buckets[b];
+			if (seen > want)
+				return std::min<uint64_t>(1ull << (b + 1), s.max_ns);
+		}
+		return s.max_ns;
+	}
+
+	public:
+	static uint64_t now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
+
+	static void record(uint32_t op, size_t size, const std::source_location &loc, uint64_t start, uint64_t end) {
+		thread_data *t = local();
+		const char *file = loc.file_name();
+		uint32_t line = loc.line();
+		uint32_t h = (uint32_t)(((uintptr_t)file >> 3) * 31 + line * 7 + op) % SLOTS;
+		uint64_t ns = end - start;
+
+		for (int i = 0; i < SLOTS; i++) {
+			uint32_t index = (h + i) % SLOTS;
+			site &s = t->sites[index];
+			const char *f = s.file.load(std::memory_order_acquire);
+			if (f == NULL) {
+				s.function = loc.function_name();
+				s.line = line;
+				s.op = op;
+				s.file.store(file, std::memory_order_release);
+			} else if (s.line != line || s.op != op || (f != file && strcmp(f, file) != 0)) {
+				continue;
+			}
+			add(s.count, 1);
+			add(s.bytes, size);
+			add(s.total_ns, ns);
+			if (ns > s.max_ns.load(std::memory_order_relaxed))
+				s.max_ns.store(ns, std::memory_order_relaxed);
+			add(s.buckets[std::min(63 - __builtin_clzll(ns | 1), BUCKETS - 1)], 1);
+
+			uint64_t head = t->event_head.load(std::memory_order_relaxed);
+			t->events[head % EVENTS] = {start, (uint32_t)std::min<uint64_t>(ns, UINT32_MAX), (uint32_t)size, index, t->tid};
+			t->event_head.store(head + 1, std::memory_order_release);
+			return;
+		}
+	}
+
+	// 合并所有线程的数据，按总耗时从高到低输出
+	static void report(FILE *fp = stdout) {
+		std::vector<summary> sites;
+		std::lock_guard<std::mutex> lk(registry_lock());
+		for (thread_data *t : registry()) {
+			for (int i = 0; i < SLOTS; i++) {
+				site &s = t->sites[i];
+				const char *file = s.file.load(std::memory_order_acquire);
+				if (file == NULL)
+					continue;
+				summary *sum = NULL;
+				for (auto &x : sites) {
+					if (x.line == s.line && x.op == s.op && strcmp(x.file, file) == 0) {
+						sum = &x;
+						break;
+					}
+				}
+				if (sum == NULL) {
+					sites.push_back(summary());
+					sum = &sites.back();
+					memset(sum, 0, sizeof(*sum));
+					sum->file = file;
+					sum->function = s.function;
+					sum->line = s.line;
+					sum->op = s.op;
+				}
+				sum->count += s.count.load(std::memory_order_relaxed);
+				sum->bytes += s.bytes.load(std::memory_order_relaxed);
+				sum->total_ns += s.total_ns.load(std::memory_order_relaxed);
+				sum->max_ns = std::max(sum->max_ns, s.max_ns.load(std::memory_order_relaxed));
+				for (int b = 0; b < BUCKETS; b++)
+					sum->buckets[b] += s.buckets[b].load(std::memory_order_relaxed);
+			}
+		}
+		std::sort(sites.begin(), sites.end(), [](const summary &a, const summary &b) {
+			return a.total_ns > b.total_ns;
+		});
+		fprintf(fp, "%-12s %10s %12s %10s %9s %9s %9s %9s  %s\n",
+			"op", "count", "bytes", "total_ms", "avg_us", "p50_us", "p99_us", "max_us", "site");
+		for (auto &s : sites) {
+			fprintf(fp, "%-12s %10lu %12lu %10.3f %9.2f %9.2f %9.2f %9.2f  %s:%u %s\n",
+				op_name(s.op), s.count, s.bytes, s.total_ns / 1e6,
+				s.count ? s.total_ns / 1e3 / s.count : 0.0,
+				percentile(s, 0.5) / 1e3, percentile(s, 0.99) / 1e3, s.max_ns / 1e3,
+				s.file, s.line, s.function);
+		}
+	}
+
+	// 输出每个线程最近 EVENTS 次调用，可在 chrome://tracing 或 Perfetto 中打开
+	static bool chrome_trace(const char *path) {
+		FILE *fp = fopen(path, "w");
+		if (fp == NULL)
+			return false;
+		bool first = true;
+		fprintf(fp, "{\"traceEvents\":[");
+		std::lock_guard<std::mutex> lk(registry_lock());
+		for (thread_data *t : registry()) {
+			uint64_t head = t->event_head.load(std::memory_order_acquire);
+			uint64_t begin = head > EVENTS ? head - EVENTS : 0;
+			for (uint64_t i = begin; i < head; i++) {
+				const event &e = t->events[i % EVENTS];
+				const site &s = t->sites[e.site % SLOTS];
+				const char *file = s.file.load(std::memory_order_acquire);
+				if (file == NULL)
+					continue;
+				const char *name = strrchr(file, '/');
+				fprintf(fp, "%s{\"name\":\"%s %s:%u\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%u,\"args\":{\"bytes\":%u}}",
+					first ? "" : ",", op_name(s.op), name ? name + 1 : file, s.line,
+					e.start_ns / 1e3, e.dur_ns / 1e3, getpid(), e.tid, e.bytes);
+				first = false;
+			}
+		}
+		fprintf(fp, "]}\n");
+		fclose(fp);
+		return true;
+	}
+};
+
+class c_profile_scope {
+	private:
+	uint32_t op;
+	size_t size;
+	const std::source_location &loc;
+	uint64_t start;
+
+	public:
+	c_profile_scope(uint32_t op, size_t size, const std::source_location &loc) : op(op), size(size), loc(loc), start(c_profiler::now()) {
+	}
+
+	~c_profile_scope() {
+		c_profiler::record(op, size, loc, start, c_profiler::now());
+	}
+};
+#else
+#define DRIVER_PROFILE_LOC
+#define DRIVER_PROFILE_ARG
+#define DRIVER_PROFILE_LOC_ONLY
+#define DRIVER_PROFILE_ARG_ONLY
+#define DRIVER_PROFILE_SCOPE(op, size)
+#endif
 
 class c_driver {
 	private:
@@ -16,8 +538,11 @@ class c_driver {
 	int has_lower = 0;
 	int has_symbol = 0;
 	int has_digit = 0;
-	int fd;
+	int fd = -1;
 	pid_t pid;
+	c_trace_recorder *recorder = NULL;
+	c_trace_replayer *replayer = NULL;
+	bool small_read_supported = true;
 
 	typedef struct _COPY_MEMORY {
 		pid_t pid;
@@ -32,11 +557,84 @@ class c_driver {
 		uintptr_t base;
 	} MODULE_BASE, *PMODULE_BASE;
 
+	static const size_t SMALL_READ_MAX = 16;
+
+	typedef struct _SMALL_MEMORY {
+		pid_t pid;
+		uint32_t size;
+		uintptr_t addr;
+		uint32_t copied;
+		uint8_t value[SMALL_READ_MAX];
+	} SMALL_MEMORY, *PSMALL_MEMORY;
+
+	typedef struct _GATHER_MEMORY {
+		pid_t pid;
+		uintptr_t base;
+		uint32_t count;
+		uint32_t stride;
+		uint32_t field_count;
+		void* fields;
+		void* buffer;
+		uint8_t* valid;
+	} GATHER_MEMORY, *PGATHER_MEMORY;
+
+	typedef struct _WAIT_MEMORY {
+		pid_t pid;
+		void* entries;
+		uint32_t count;
+		uint32_t timeout_ms;
+		uint32_t interval_us;
+		int32_t hit;
+	} WAIT_MEMORY, *PWAIT_MEMORY;
+
+	typedef struct _QUERY_PAGES {
+		pid_t pid;
+		uintptr_t addr;
+		size_t size;
+		uint8_t* buffer;
+	} QUERY_PAGES, *PQUERY_PAGES;
+
+	typedef struct _PROGRAM_MEMORY {
+		pid_t pid;
+		void* insns;
+		uint32_t insn_count;
+		uint32_t step_budget;
+		uint32_t byte_budget;
+		uint32_t output_size;
+		void* output;
+		uint64_t regs[8];
+		uint32_t status;
+		uint32_t output_used;
+		uint32_t steps;
+		uint32_t fault_pc;
+	} PROGRAM_MEMORY, *PPROGRAM_MEMORY;
+
+	typedef struct _PIN_MEMORY {
+		pid_t pid;
+		void* entries;
+		uint32_t count;
+	} PIN_MEMORY, *PPIN_MEMORY;
+
+	typedef struct _EVENT_SUBSCRIBE {
+		pid_t pid;
+		const char* pattern;
+		uint32_t interval_ms;
+	} EVENT_SUBSCRIBE, *PEVENT_SUBSCRIBE;
+
 	enum OPERATIONS {
 		OP_INIT_KEY = 0x800,
 		OP_READ_MEM = 0x801,
 		OP_WRITE_MEM = 0x802,
 		OP_MODULE_BASE = 0x803,
+		OP_GATHER_MEM = 0x807,
+		OP_WAIT_MEM = 0x808,
+		OP_QUERY_PAGES = 0x809,
+		OP_RUN_PROGRAM = 0x80A,
+		OP_PIN_MEM = 0x80B,
+		OP_PIN_STATS = 0x80C,
+		OP_SET_TARGET = 0x80D,
+		OP_SUBSCRIBE_EVENTS = 0x80E,
+		OP_READ_SMALL = 0x80F,
 	};
 	
 	int symbol_file(const char *filename) {
@@ -156,13 +754,156 @@ class c_driver {
 		return 0;
 	}
 	
+	// 不计入性能统计的读取，供已在统计范围内的调用复用
+	bool read_memory(uintptr_t addr, void *buffer, size_t size) {
+		COPY_MEMORY cm;
+
+		if (replayer != NULL) {
+			return replayer->read(addr, buffer, size);
+		}
+		cm.pid = this->pid;
+		cm.addr = addr;
+		cm.buffer = buffer;
+		cm.size = size;
+
+		bool ok = ioctl(fd, OP_READ_MEM, &cm) == 0;
+		if (recorder != NULL) {
+			recorder->record_read(addr, buffer, size, ok);
+		}
+		return ok;
+	}
+
+	template <typename T>
+	bool read_as(uintptr_t addr, T *res, std::true_type DRIVER_PROFILE_LOC) {
+		return this->read_small(addr, res, sizeof(T) DRIVER_PROFILE_ARG);
+	}
+
+	template <typename T>
+	bool read_as(uintptr_t addr, T *res, std::false_type DRIVER_PROFILE_LOC) {
+		return this->read(addr, res, sizeof(T) DRIVER_PROFILE_ARG);
+	}
+
 	public:
+	typedef struct _GATHER_FIELD {
+		uint32_t offset;
+		uint32_t size;
+	} GATHER_FIELD, *PGATHER_FIELD;
+
+	enum WATCH_CONDITION {
+		WATCH_CHANGED = 0,
+		WATCH_EQUAL = 1,
+		WATCH_NOT_EQUAL = 2,
+		WATCH_GREATER = 3,
+		WATCH_LESS = 4,
+	};
+
+	typedef struct _WATCH_ENTRY {
+		uintptr_t addr;
+		uint32_t size;
+		uint32_t condition;
+		uint64_t value;
+	} WATCH_ENTRY, *PWATCH_ENTRY;
+
+	enum PAGE_ATTR {
+		PAGE_ATTR_PRESENT = 0x01,
+		PAGE_ATTR_SWAPPED = 0x02,
+		PAGE_ATTR_WRITE = 0x04,
+		PAGE_ATTR_DIRTY = 0x08,
+		PAGE_ATTR_HUGE_PMD = 0x10,
+		PAGE_ATTR_HUGE_PUD = 0x20,
+	};
+
+	enum PROGRAM_OPCODE {
+		PROG_EXIT = 0,
+		PROG_LDI,
+		PROG_MOV,
+		PROG_ADD,
+		PROG_ADDI,
+		PROG_READ,
+		PROG_DEREF,
+		PROG_JEQ,
+		PROG_JNE,
+		PROG_JLT,
+		PROG_JGE,
+		PROG_JEQI,
+		PROG_JNEI,
+		PROG_LOOP,
+		PROG_EMIT,
+		PROG_EMITM,
+	};
+
+	enum PROGRAM_STATUS {
+		PROG_OK = 0,
+		PROG_FAULT,
+		PROG_STEP_LIMIT,
+		PROG_BYTE_LIMIT,
+		PROG_OUTPUT_FULL,
+	};
+
+	static const uint32_t PROG_NO_TARGET = 0xFFFFFFFF;
+
+	typedef struct _PROGRAM_INSN {
+		uint8_t op;
+		uint8_t dst;
+		uint8_t src;
+		uint8_t size;
+		uint32_t target;
+		uint64_t imm;
+	} PROGRAM_INSN, *PPROGRAM_INSN;
+
+	typedef struct _PIN_ENTRY {
+		uintptr_t addr;
+		uint32_t size;
+		uint32_t interval_ms;
+		uint8_t value[16];
+		uint64_t hits;
+		uint64_t misses;
+	} PIN_ENTRY, *PPIN_ENTRY;
+
+	enum EVENT_TYPE {
+		EVENT_EXIT = 1,
+		EVENT_EXEC = 2,
+		EVENT_MAP = 3,
+		EVENT_UNMAP = 4,
+	};
+
+	typedef struct _MEM_EVENT {
+		uint32_t type;
+		pid_t pid;
+		uintptr_t start;
+		uintptr_t end;
+		char path[256];
+	} MEM_EVENT, *PMEM_EVENT;
+
+	struct program_result {
+		uint32_t status;
+		uint32_t output_used;
+		uint32_t steps;
+		uint32_t fault_pc;
+		uint64_t regs[8];
+	};
+
+	// 设置环境变量 DRIVER_REPLAY=<轨迹文件> 时不打开驱动，所有读取由轨迹回放
+	// 设置环境变量 DRIVER_RECORD=<轨迹文件> 时录制所有读取
 	c_driver() {
+		const char *replay_path = getenv("DRIVER_REPLAY");
+		if (replay_path != NULL) {
+			replayer = new c_trace_replayer();
+			if (!replayer->open(replay_path)) {
+				printf("[-] open trace failed\n");
+				exit(0);
+			}
+			return;
+		}
 		open_driver();
 		if (fd <= 0) {
 			printf("[-] open driver failed\n");
 			exit(0);
 		}
+		const char *record_path = getenv("DRIVER_RECORD");
+		if (record_path != NULL) {
+			start_recording(record_path);
+		}
 	}
 
 	~c_driver() {
@@ -173,6 +914,46 @@ class c_driver {
 
 	void initialize(pid_t pid) {
 		this->pid = pid;
+		if (replayer == NULL) {
+			ioctl(fd, OP_SET_TARGET, &pid);
+		}
+	}
+
+	// 驱动文件描述符，initialize 之后 pread/pwrite/preadv 的偏移即目标虚拟地址
+	int handle() {
+		return fd;
+	}
+
+	// 从 addr 开始的连续内存依次填入 iov，返回读取的字节数，遇到缺页时提前结束
+	// 录制时每段记为一次读取，只读到一部分的段记为失败，回放时按段依次读取
+	ssize_t readv(uintptr_t addr, const struct iovec *iov, int count DRIVER_PROFILE_LOC) {
+		size_t total = 0;
+		for (int i = 0; i < count; i++)
+			total += iov[i].iov_len;
+		DRIVER_PROFILE_SCOPE(PROFILE_READ, total);
+
+		size_t offset = 0;
+		if (replayer != NULL) {
+			for (int i = 0; i < count; i++) {
+				if (!replayer->read(addr + offset, iov[i].iov_base, iov[i].iov_len))
+					break;
+				offset += iov[i].iov_len;
+			}
+			return offset;
+		}
+
+		ssize_t done = preadv(fd, iov, count, (off_t)addr);
+		if (recorder != NULL) {
+			size_t copied = done > 0 ? done : 0;
+			for (int i = 0; i < count; i++) {
+				bool ok = offset + iov[i].iov_len <= copied;
+				recorder->record_read(addr + offset, iov[i].iov_base, iov[i].iov_len, ok);
+				if (!ok)
+					break;
+				offset += iov[i].iov_len;
+			}
+		}
+		return done;
 	}
 
 	bool init_key(char* key) {
@@ -184,22 +965,47 @@ class c_driver {
 		return true;
 	}
 
-	bool read(uintptr_t addr, void *buffer, size_t size) {
-		COPY_MEMORY cm;
-
-		cm.pid = this->pid;
-		cm.addr = addr;
-		cm.buffer = buffer;
-		cm.size = size;
-
-		if (ioctl(fd, OP_READ_MEM, &cm) != 0) {
+	bool start_recording(const char *path) {
+		c_trace_recorder *r = new c_trace_recorder();
+		if (!r->open(path)) {
+			delete r;
 			return false;
 		}
+		stop_recording();
+		recorder = r;
 		return true;
 	}
 
-	bool write(uintptr_t addr, void *buffer, size_t size) {
+	void stop_recording() {
+		if (recorder != NULL) {
+			recorder->close();
+			delete recorder;
+			recorder = NULL;
+		}
+	}
+
+	bool replaying() {
+		return replayer != NULL;
+	}
+
+	void record_module_base(const char *name, uintptr_t base) {
+		if (recorder != NULL) {
+			recorder->record_module_base(name, base);
+		}
+	}
+
+	bool read(uintptr_t addr, void *buffer, size_t size DRIVER_PROFILE_LOC) {
+		DRIVER_PROFILE_SCOPE(PROFILE_READ, size);
+		return this->read_memory(addr, buffer, size);
+	}
+
+	bool write(uintptr_t addr, void *buffer, size_t size DRIVER_PROFILE_LOC) {
 		COPY_MEMORY cm;
+		DRIVER_PROFILE_SCOPE(PROFILE_WRITE, size);
+
+		if (replayer != NULL) {
+			return true;
+		}
 
 		cm.pid = this->pid;
 		cm.addr = addr;
@@ -212,41 +1018,249 @@ class c_driver {
 		return true;
 	}
 
+	// 不超过 SMALL_READ_MAX 字节的读取，值随参数结构体一起返回
+	bool read_small(uintptr_t addr, void *buffer, size_t size DRIVER_PROFILE_LOC) {
+		SMALL_MEMORY sm;
+
+		if (replayer != NULL || !small_read_supported || size > SMALL_READ_MAX) {
+			return this->read(addr, buffer, size DRIVER_PROFILE_ARG);
+		}
+		DRIVER_PROFILE_SCOPE(PROFILE_READ, size);
+		sm.pid = this->pid;
+		sm.size = size;
+		sm.addr = addr;
+		sm.copied = 0xFFFFFFFF;
+
+		bool ok = ioctl(fd, OP_READ_SMALL, &sm) == 0;
+		if (ok && sm.copied == 0xFFFFFFFF) {
+			//旧版驱动不支持该操作，回退读取与探测合计为一次调用
+			small_read_supported = false;
+			return this->read_memory(addr, buffer, size);
+		}
+		if (ok) {
+			memcpy(buffer, sm.value, size);
+		}
+		if (recorder != NULL) {
+			recorder->record_read(addr, buffer, size, ok);
+		}
+		return ok;
+	}
+
+	// 按类型大小在编译期选择读取方式
 	template <typename T>
-	T read(uintptr_t addr) {
+	T read(uintptr_t addr DRIVER_PROFILE_LOC) {
 		T res;
-		if (this->read(addr, &res, sizeof(T)))
+		if (this->read_as(addr, &res, std::integral_constant<bool, sizeof(T) <= SMALL_READ_MAX>() DRIVER_PROFILE_ARG))
 			return res;
 		return {};
 	}
 
 	template <typename T>
-	bool write(uintptr_t addr,T value) {
-		return this->write(addr, &value, sizeof(T));
+	bool write(uintptr_t addr,T value DRIVER_PROFILE_LOC) {
+		return this->write(addr, &value, sizeof(T) DRIVER_PROFILE_ARG);
 	}
 
-	uintptr_t get_module_base(char* name) {
-		MODULE_BASE mb;
-		char buf[0x100];
-		strcpy(buf,name);
-		mb.pid = this->pid;
-		mb.name = buf;
+	// 一次调用读取 count 个对象的若干字段
+	// stride 非 0 时对象位于 base + i * stride，为 0 时 base 为对象指针数组
+	// buffer 按字段依次存放 count 个值，大小为 count * sum(fields[i].size)
+	// valid 每个对象一位，对象的所有字段都读取成功时置位，大小为 (count + 7) / 8
+	bool gather(uintptr_t base, uint32_t count, uint32_t stride, const GATHER_FIELD *fields, uint32_t field_count, void *buffer, uint8_t *valid) {
+		GATHER_MEMORY gm;
 
-		if (ioctl(fd, OP_MODULE_BASE, &mb) != 0) {
-			return 0;
+		if (recorder != NULL || replayer != NULL) {
+			return gather_by_read(base, count, stride, fields, field_count, buffer, valid);
 		}
-		return mb.base;
+		gm.pid = this->pid;
+		gm.base = base;
+		gm.count = count;
+		gm.stride = stride;
+		gm.field_count = field_count;
+		gm.fields = (void *)fields;
+		gm.buffer = buffer;
+		gm.valid = valid;
+
+		if (ioctl(fd, OP_GATHER_MEM, &gm) != 0) {
+			return false;
+		}
+		return true;
 	}
-};
 
-static c_driver *driver = new c_driver();
+	// 录制和回放时逐个读取，使轨迹中包含每次实际访问
+	bool gather_by_read(uintptr_t base, uint32_t count, uint32_t stride, const GATHER_FIELD *fields, uint32_t field_count, void *buffer, uint8_t *valid) {
+		std::vector<uintptr_t> pointers;
+		size_t field_base = 0;
 
-/*--------------------------------------------------------------------------------------------------------*/
+		if (stride == 0) {
+			pointers.resize(count);
+			this->read(base, pointers.data(), count * sizeof(uintptr_t));
+		}
+		memset(valid, 0xff, (count + 7) / 8);
+		for (uint32_t f = 0; f < field_count; f++) {
+			uint8_t *out = (uint8_t *)buffer + field_base;
+			for (uint32_t i = 0; i < count; i++) {
+				uintptr_t elem = stride ? base + (uintptr_t)i * stride : pointers[i] & 0xFFFFFFFFFFFF;
+				memset(out + (size_t)i * fields[f].size, 0, fields[f].size);
+				if (elem == 0 || !this->read(elem + fields[f].offset, out + (size_t)i * fields[f].size, fields[f].size))
+					valid[i / 8] &= ~(1 << (i % 8));
+			}
+			field_base += (size_t)fields[f].size * count;
+		}
+		if (count % 8)
+			valid[count / 8] &= (1 << (count % 8)) - 1;
+		return true;
+	}
 
-typedef char PACKAGENAME;	// 包名
-pid_t pid;	// 进程ID
+	// 在内核中等待任一条目满足条件，返回条目下标，超时或失败返回 -1，被信号中断时 errno 为 EINTR
+	// 返回时 entries[i].value 为各地址的当前值
+	int wait(WATCH_ENTRY *entries, uint32_t count, uint32_t timeout_ms, uint32_t interval_us = 0) {
+		WAIT_MEMORY wm;
 
-float Kernel_v()
+		if (replayer != NULL) {
+			return -1;
+		}
+		wm.pid = this->pid;
+		wm.entries = entries;
+		wm.count = count;
+		wm.timeout_ms = timeout_ms;
+		wm.interval_us = interval_us;
+		wm.hit = -1;
+
+		if (ioctl(fd, OP_WAIT_MEM, &wm) != 0) {
+			return -1;
+		}
+		return wm.hit;
+	}
+
+	// 查询范围内每页的 PAGE_ATTR_* 属性，buffer 大小为覆盖范围的页数
+	bool query_pages(uintptr_t addr, size_t size, uint8_t *buffer) {
+		QUERY_PAGES qp;
+
+		if (replayer != NULL) {
+			return false;
+		}
+		qp.pid = this->pid;
+		qp.addr = addr;
+		qp.size = size;
+		qp.buffer = buffer;
+
+		if (ioctl(fd, OP_QUERY_PAGES, &qp) != 0) {
+			return false;
+		}
+		return true;
+	}
+
+	// 在内核中执行读取程序，regs 为初始寄存器(可为 NULL)，结果写入 output
+	bool run_program(const PROGRAM_INSN *insns, uint32_t count, void *output, uint32_t output_size,
+		program_result *result, const uint64_t *regs = NULL, uint32_t byte_budget = 0x100000, uint32_t step_budget = 0) {
+		PROGRAM_MEMORY pm;
+
+		if (replayer != NULL) {
+			return false;
+		}
+		memset(&pm, 0, sizeof(pm));
+		pm.pid = this->pid;
+		pm.insns = (void *)insns;
+		pm.insn_count = count;
+		pm.step_budget = step_budget;
+		pm.byte_budget = byte_budget;
+		pm.output_size = output_size;
+		pm.output = output;
+		if (regs != NULL) {
+			memcpy(pm.regs, regs, sizeof(pm.regs));
+		}
+
+		if (ioctl(fd, OP_RUN_PROGRAM, &pm) != 0) {
+			return false;
+		}
+		if (result != NULL) {
+			result->status = pm.status;
+			result->output_used = pm.output_used;
+			result->steps = pm.steps;
+			result->fault_pc = pm.fault_pc;
+			memcpy(result->regs, pm.regs, sizeof(pm.regs));
+		}
+		return true;
+	}
+
+	// 由内核按各自间隔持续写入固定值，替换当前进程之前的锁定，count 为 0 时全部解除
+	// 目标进程退出后自动解除
+	bool pin(const PIN_ENTRY *entries, uint32_t count) {
+		PIN_MEMORY pm;
+
+		if (replayer != NULL) {
+			return true;
+		}
+		pm.pid = this->pid;
+		pm.entries = (void *)entries;
+		pm.count = count;
+
+		if (ioctl(fd, OP_PIN_MEM, &pm) != 0) {
+			return false;
+		}
+		return true;
+	}
+
+	// 读取当前锁定及命中统计，返回锁定数量，失败返回 -1
+	int pin_stats(PIN_ENTRY *entries, uint32_t capacity) {
+		PIN_MEMORY pm;
+
+		if (replayer != NULL) {
+			return 0;
+		}
+		pm.pid = this->pid;
+		pm.entries = entries;
+		pm.count = capacity;
+
+		if (ioctl(fd, OP_PIN_STATS, &pm) != 0) {
+			return -1;
+		}
+		return pm.count;
+	}
+
+	// 订阅当前进程的退出、exec 和文件映射变化，返回事件流描述符，失败返回 -1
+	// 对返回的描述符 poll 等待，read 得到 MEM_EVENT 数组，进程退出且事件取完后 read 返回 0；pattern 为路径过滤字符串，可为 NULL
+	int subscribe_events(const char *pattern = NULL, uint32_t interval_ms = 0) {
+		EVENT_SUBSCRIBE sub;
+
+		if (replayer != NULL) {
+			return -1;
+		}
+		sub.pid = this->pid;
+		sub.pattern = pattern;
+		sub.interval_ms = interval_ms;
+
+		int events_fd = ioctl(fd, OP_SUBSCRIBE_EVENTS, &sub);
+		return events_fd > 0 ? events_fd : -1;
+	}
+
+	uintptr_t get_module_base(char* name DRIVER_PROFILE_LOC) {
+		MODULE_BASE mb;
+		char buf[0x100];
+		DRIVER_PROFILE_SCOPE(PROFILE_MODULE_BASE, 0);
+
+		if (replayer != NULL) {
+			return replayer->module_base(name);
+		}
+		strcpy(buf,name);
+		mb.pid = this->pid;
+		mb.name = buf;
+
+		if (ioctl(fd, OP_MODULE_BASE, &mb) != 0) {
+			return 0;
+		}
+		record_module_base(name, mb.base);
+		return mb.base;
+	}
+};
+
+static c_driver *driver = new c_driver();
+
+/*--------------------------------------------------------------------------------------------------------*/
+
+typedef char PACKAGENAME;	// 包名
+pid_t pid;	// 进程ID
+
+float Kernel_v()
 {
 	const char* command = "uname -r | sed 's/\\.[^.]*$//g'";
 	FILE* file = popen(command, "r");
@@ -363,57 +1377,840 @@ long GetModuleBaseAddr(char* module_name)
     return addr;
 }
 
-long getModuleBase(char* module_name)
+long getModuleBase(char* module_name DRIVER_PROFILE_LOC)
 {
 	uintptr_t base=0;
-	if (Kernel_v() >= 6.0)
+	if (Kernel_v() >= 6.0 && !driver->replaying()) {
 		base = GetModuleBaseAddr(module_name);
+		driver->record_module_base(module_name, base);
+	}
 	else
-		base = driver->get_module_base(module_name);
+		base = driver->get_module_base(module_name DRIVER_PROFILE_ARG);
 	return base;
 }
 
-long ReadValue(long addr)
+long ReadValue(long addr DRIVER_PROFILE_LOC)
 {
 	long he=0;
 	if (addr < 0xFFFFFFFF){
-		driver->read(addr, &he, 4);
+		he = driver->read<uint32_t>(addr DRIVER_PROFILE_ARG);
 	}else{
-		driver->read(addr, &he, 8);
+		he = driver->read<uint64_t>(addr DRIVER_PROFILE_ARG);
 		he=he&0xFFFFFFFFFFFF;
 	}
 	return he;
 }
 
-long ReadDword(long addr)
+long ReadDword(long addr DRIVER_PROFILE_LOC)
 {
-	long he=0;
-	driver->read(addr, &he, 4);
-	return he;
+	return driver->read<uint32_t>(addr DRIVER_PROFILE_ARG);
 }
 
-float ReadFloat(long addr)
+float ReadFloat(long addr DRIVER_PROFILE_LOC)
 {
-	float he=0;
-	driver->read(addr, &he, 4);
-	return he;
+	return driver->read<float>(addr DRIVER_PROFILE_ARG);
 }
 
-int *ReadArray(long addr)
+int *ReadArray(long addr DRIVER_PROFILE_LOC)
 {
 	int *he = (int *) malloc(12);
-	driver->read(addr, he, 12);
+	driver->read(addr, he, 12 DRIVER_PROFILE_ARG);
 	return he;
 }
 
-int WriteDword(long int addr, int value)
+int WriteDword(long int addr, int value DRIVER_PROFILE_LOC)
 {
-	driver->write(addr, &value, 4);
+	driver->write(addr, &value, 4 DRIVER_PROFILE_ARG);
 	return 0;
 }
 
-int WriteFloat(long int addr, float value)
+int WriteFloat(long int addr, float value DRIVER_PROFILE_LOC)
 {
-	driver->write(addr, &value, 4);
+	driver->write(addr, &value, 4 DRIVER_PROFILE_ARG);
 	return 0;
-}
\ No newline at end of file
+}
+
+/*--------------------------------------------------------------------------------------------------------*/
+
+// 工作窃取线程池：每个线程优先处理自己队列尾部的任务，空闲时从其他线程队列头部窃取
+class c_thread_pool {
+	private:
+	typedef std::function<void()> task_t;
+
+	struct worker_queue {
+		std::mutex lock;
+		std::deque<task_t> tasks;
+	};
+
+	std::vector<worker_queue *> queues;
+	std::vector<std::thread> threads;
+	std::atomic<long> queued{0};
+	std::atomic<long> pending{0};
+	std::atomic<unsigned> next_queue{0};
+	std::atomic<bool> stopping{false};
+	std::mutex idle_lock;
+	std::condition_variable idle_cv;
+	std::condition_variable done_cv;
+
+	struct worker_id {
+		c_thread_pool *pool;
+		size_t index;
+	};
+
+	static worker_id &current() {
+		static thread_local worker_id id = {NULL, 0};
+		return id;
+	}
+
+	bool take(size_t index, task_t &task) {
+		worker_queue *own = queues[index];
+		{
+			std::lock_guard<std::mutex> lk(own->lock);
+			if (!own->tasks.empty()) {
+				task = std::move(own->tasks.back());
+				own->tasks.pop_back();
+				queued--;
+				return true;
+			}
+		}
+		for (size_t i = 1; i < queues.size(); i++) {
+			worker_queue *victim = queues[(index + i) % queues.size()];
+			std::lock_guard<std::mutex> lk(victim->lock);
+			if (!victim->tasks.empty()) {
+				task = std::move(victim->tasks.front());
+				victim->tasks.pop_front();
+				queued--;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void worker(size_t index) {
+		current().pool = this;
+		current().index = index;
+		task_t task;
+		while (!stopping) {
+			if (!take(index, task)) {
+				std::unique_lock<std::mutex> lk(idle_lock);
+				idle_cv.wait(lk, [this] { return stopping || queued > 0; });
+				continue;
+			}
+			task();
+			task = nullptr;
+			if (--pending == 0) {
+				std::lock_guard<std::mutex> lk(idle_lock);
+				done_cv.notify_all();
+			}
+		}
+	}
+
+	public:
+	c_thread_pool(size_t count = 0) {
+		if (count == 0)
+			count = std::max(1u, std::thread::hardware_concurrency());
+		for (size_t i = 0; i < count; i++)
+			queues.push_back(new worker_queue());
+		for (size_t i = 0; i < count; i++)
+			threads.emplace_back(&c_thread_pool::worker, this, i);
+	}
+
+	~c_thread_pool() {
+		{
+			std::lock_guard<std::mutex> lk(idle_lock);
+			stopping = true;
+		}
+		idle_cv.notify_all();
+		for (auto &t : threads)
+			t.join();
+		for (auto q : queues)
+			delete q;
+	}
+
+	size_t size() const {
+		return threads.size();
+	}
+
+	void submit(task_t task) {
+		size_t index;
+		if (current().pool == this)
+			index = current().index;
+		else
+			index = next_queue++ % queues.size();
+		pending++;
+		{
+			std::lock_guard<std::mutex> lk(queues[index]->lock);
+			queues[index]->tasks.push_back(std::move(task));
+		}
+		queued++;
+		{
+			std::lock_guard<std::mutex> lk(idle_lock);
+		}
+		idle_cv.notify_one();
+	}
+
+	// 等待所有已提交的任务(包括任务中派生的任务)完成
+	void wait() {
+		std::unique_lock<std::mutex> lk(idle_lock);
+		done_cv.wait(lk, [this] { return pending == 0; });
+	}
+};
+
+// 指针扫描器：快照可写内存，建立 值->地址 的反向指针表，从目标地址向模块静态区回溯
+// 按深度逐层展开，每个节点优先展开偏移最小的 max_candidates 个指针；同一地址只在首次到达的层展开一次，
+// 经其他偏移到达该地址的链不再展开，因此结果不是全部可能的链，但同一快照的结果是确定的
+class c_pointer_scanner {
+	public:
+	struct pointer_chain {
+		std::string module;
+		uintptr_t module_offset;
+		std::vector<uintptr_t> offsets;	// [[module+module_offset]+offsets[0]]+offsets[1]...
+	};
+
+	size_t max_depth = 5;
+	uintptr_t max_offset = 0x1000;
+	size_t max_results = 100000;
+	size_t max_candidates = 64;		// 每个节点最多向上展开的指针数
+	size_t max_tasks = 1000000;		// 单次扫描最多展开的节点数
+	size_t chunk_size = 0x100000;
+
+	private:
+	struct region {
+		uintptr_t start;
+		uintptr_t end;
+		bool writable;
+		bool is_static;
+		std::string module;
+	};
+
+	struct pointer_entry {
+		uintptr_t value;
+		uintptr_t location;
+		bool operator<(const pointer_entry &o) const {
+			return value < o.value || (value == o.value && location < o.location);
+		}
+	};
+
+	pid_t target_pid;
+	c_thread_pool pool;
+	std::vector<region> regions;
+	std::vector<std::pair<std::string, uintptr_t>> modules;
+	std::vector<pointer_entry> pointers;
+	std::vector<std::vector<pointer_entry>> runs;
+	std::mutex results_lock;
+	std::vector<pointer_chain> results;
+	bool truncated = false;
+
+	// 待展开的节点：location 处的值加上 offsets 可到达目标
+	struct node {
+		uintptr_t location;
+		std::vector<uintptr_t> offsets;
+	};
+
+	// 每个节点的展开结果，按层内顺序合并
+	struct expansion {
+		std::vector<pointer_chain> found;
+		std::vector<node> next;
+	};
+
+	const region *find_region(uintptr_t addr) const {
+		auto it = std::upper_bound(regions.begin(), regions.end(), addr,
+			[](uintptr_t a, const region &r) { return a < r.start; });
+		if (it == regions.begin())
+			return NULL;
+		--it;
+		return addr < it->end ? &*it : NULL;
+	}
+
+	uintptr_t module_base(const std::string &name) const {
+		for (auto &m : modules) {
+			if (m.first == name)
+				return m.second;
+		}
+		return 0;
+	}
+
+	bool load_maps() {
+		char filename[32];
+		char line[1024];
+		snprintf(filename, sizeof(filename), "/proc/%d/maps", target_pid);
+		FILE *fp = fopen(filename, "r");
+		if (fp == NULL)
+			return false;
+		regions.clear();
+		modules.clear();
+		std::string last_module;
+		while (fgets(line, sizeof(line), fp)) {
+			uintptr_t start, end;
+			char perms[8];
+			int path_pos = 0;
+			if (sscanf(line, "%lx-%lx %7s %*s %*s %*s %n", &start, &end, perms, &path_pos) < 3)
+				continue;
+			char *path = line + path_pos;
+			path[strcspn(path, "\n")] = '\0';
+			if (perms[0] != 'r' || strncmp(path, "/dev/", 5) == 0)
+				continue;
+
+			region r;
+			r.start = start;
+			r.end = end;
+			r.writable = perms[1] == 'w';
+			r.is_static = false;
+			if (path[0] == '/') {
+				const char *name = strrchr(path, '/') + 1;
+				last_module = name;
+				if (module_base(last_module) == 0)
+					modules.push_back(std::make_pair(last_module, start));
+				r.is_static = r.writable;
+				r.module = last_module;
+			} else if (strcmp(path, "[anon:.bss]") == 0 && !last_module.empty()) {
+				// .bss 紧跟在所属模块的映射之后
+				r.is_static = true;
+				r.module = last_module;
+			} else {
+				last_module.clear();
+			}
+			regions.push_back(r);
+		}
+		fclose(fp);
+		return true;
+	}
+
+	void scan_chunk(uintptr_t start, size_t size DRIVER_PROFILE_LOC) {
+		std::vector<uintptr_t> buffer(size / sizeof(uintptr_t), 0);
+		driver->read(start, buffer.data(), size DRIVER_PROFILE_ARG);
+		std::vector<pointer_entry> found;
+		for (size_t i = 0; i < buffer.size(); i++) {
+			uintptr_t value = buffer[i] & 0xFFFFFFFFFFFF;
+			if (value == 0 || !find_region(value))
+				continue;
+			found.push_back({value, start + i * sizeof(uintptr_t)});
+		}
+		std::sort(found.begin(), found.end());
+		std::lock_guard<std::mutex> lk(results_lock);
+		runs.push_back(std::move(found));
+	}
+
+	void merge_runs() {
+		while (runs.size() > 1) {
+			std::vector<std::vector<pointer_entry>> merged((runs.size() + 1) / 2);
+			for (size_t i = 0; i < merged.size(); i++) {
+				pool.submit([this, &merged, i] {
+					if (i * 2 + 1 >= runs.size()) {
+						merged[i] = std::move(runs[i * 2]);
+						return;
+					}
+					auto &a = runs[i * 2];
+					auto &b = runs[i * 2 + 1];
+					merged[i].resize(a.size() + b.size());
+					std::merge(a.begin(), a.end(), b.begin(), b.end(), merged[i].begin());
+					std::vector<pointer_entry>().swap(a);
+					std::vector<pointer_entry>().swap(b);
+				});
+			}
+			pool.wait();
+			runs.swap(merged);
+		}
+		if (runs.empty())
+			pointers.clear();
+		else
+			pointers = std::move(runs[0]);
+		runs.clear();
+	}
+
+	// 从 target 向下查找指向 [target - max_offset, target] 的指针，偏移小的优先
+	void expand(uintptr_t target, const std::vector<uintptr_t> &offsets, bool deeper, expansion &out) {
+		uintptr_t low = target > max_offset ? target - max_offset : 0;
+		auto it = std::upper_bound(pointers.begin(), pointers.end(), pointer_entry{target, UINTPTR_MAX});
+		size_t expanded = 0;
+		while (it != pointers.begin()) {
+			--it;
+			if (it->value < low)
+				break;
+			std::vector<uintptr_t> chain;
+			chain.reserve(offsets.size() + 1);
+			chain.push_back(target - it->value);
+			chain.insert(chain.end(), offsets.begin(), offsets.end());
+
+			const region *r = find_region(it->location);
+			if (r && r->is_static) {
+				out.found.push_back({r->module, it->location - module_base(r->module), std::move(chain)});
+			} else if (deeper && expanded < max_candidates) {
+				expanded++;
+				out.next.push_back({it->location, std::move(chain)});
+			}
+		}
+	}
+
+	void search(uintptr_t target) {
+		std::unordered_set<uintptr_t> visited;
+		std::vector<node> level;
+		size_t tasks = 1;
+		level.push_back({target, std::vector<uintptr_t>()});
+		for (size_t depth = 0; !level.empty(); depth++) {
+			std::vector<expansion> out(level.size());
+			bool deeper = depth + 1 < max_depth;
+			for (size_t i = 0; i < level.size(); i += 256) {
+				size_t end = std::min(level.size(), i + 256);
+				pool.submit([this, &level, &out, i, end, deeper] {
+					for (size_t k = i; k < end; k++)
+						expand(level[k].location, level[k].offsets, deeper, out[k]);
+				});
+			}
+			pool.wait();
+
+			std::vector<node> next;
+			for (auto &e : out) {
+				for (auto &c : e.found) {
+					if (results.size() >= max_results) {
+						truncated = true;
+						return;
+					}
+					results.push_back(std::move(c));
+				}
+				for (auto &n : e.next) {
+					if (!visited.insert(n.location).second)
+						continue;
+					if (tasks >= max_tasks) {
+						truncated = true;
+						break;
+					}
+					tasks++;
+					next.push_back(std::move(n));
+				}
+			}
+			level.swap(next);
+		}
+	}
+
+	public:
+	c_pointer_scanner(pid_t pid, size_t threads = 0) : target_pid(pid), pool(threads) {
+	}
+
+	// 快照可写内存并建立反向指针表，返回指针数量
+	size_t snapshot(DRIVER_PROFILE_LOC_ONLY) {
+		pointers.clear();
+		if (!load_maps())
+			return 0;
+		for (auto &r : regions) {
+			if (!r.writable)
+				continue;
+			for (uintptr_t addr = r.start; addr < r.end; addr += chunk_size) {
+				size_t size = std::min<uintptr_t>(chunk_size, r.end - addr);
+#ifdef DRIVER_PROFILE
+				pool.submit([this, addr, size, loc] { scan_chunk(addr, size, loc); });
+#else
+				pool.submit([this, addr, size] { scan_chunk(addr, size); });
+#endif
+			}
+		}
+		pool.wait();
+		merge_runs();
+		return pointers.size();
+	}
+
+	// 结果按链长、模块、偏移排序；达到 max_results 或 max_tasks 上限时 was_truncated() 返回 true
+	std::vector<pointer_chain> scan(uintptr_t target) {
+		results.clear();
+		truncated = false;
+		search(target);
+		std::sort(results.begin(), results.end(), [](const pointer_chain &a, const pointer_chain &b) {
+			if (a.offsets.size() != b.offsets.size())
+				return a.offsets.size() < b.offsets.size();
+			if (a.module != b.module)
+				return a.module < b.module;
+			if (a.module_offset != b.module_offset)
+				return a.module_offset < b.module_offset;
+			return a.offsets < b.offsets;
+		});
+		return results;
+	}
+
+	// 上一次扫描是否因上限提前结束
+	bool was_truncated() const {
+		return truncated;
+	}
+
+	// 按指针链读取最终地址，用于验证扫描结果
+	uintptr_t resolve(const pointer_chain &chain DRIVER_PROFILE_LOC) {
+		uintptr_t addr = module_base(chain.module) + chain.module_offset;
+		for (auto off : chain.offsets)
+			addr = (driver->read<uintptr_t>(addr DRIVER_PROFILE_ARG) & 0xFFFFFFFFFFFF) + off;
+		return addr;
+	}
+
+	void dump(const std::vector<pointer_chain> &chains, FILE *fp = stdout) {
+		for (auto &c : chains) {
+			fprintf(fp, "%s+0x%lx", c.module.c_str(), c.module_offset);
+			for (auto off : c.offsets)
+				fprintf(fp, " -> 0x%lx", off);
+			fprintf(fp, "\n");
+		}
+	}
+};
+
+
+/*--------------------------------------------------------------------------------------------------------*/
+
+// UE4 容器读取：头部和数据各一次读取，长度均有上限
+#define UE_MAX_ARRAY_NUM 0x100000
+#define UE_MAX_STRING_LEN 0x1000
+#define UE_MAX_OBJECTS 0x400000
+#define UE_OBJECT_CHUNK 0x10000
+
+struct FArrayHeader {
+	uintptr_t data;
+	int32_t num;
+	int32_t max;
+};
+
+struct FNameValue {
+	int32_t index;
+	int32_t number;
+};
+
+template <typename T>
+bool ReadTArray(long addr, std::vector<T> &out, int32_t max_num = UE_MAX_ARRAY_NUM DRIVER_PROFILE_LOC)
+{
+	FArrayHeader header;
+	out.clear();
+	if (!driver->read(addr, &header, sizeof(header) DRIVER_PROFILE_ARG))
+		return false;
+	if (header.num < 0 || header.num > header.max || header.num > max_num)
+		return false;
+	if (header.num == 0)
+		return true;
+	out.resize(header.num);
+	return driver->read(header.data & 0xFFFFFFFFFFFF, out.data(), header.num * sizeof(T) DRIVER_PROFILE_ARG);
+}
+
+std::string Utf16ToUtf8(const char16_t *str, size_t len)
+{
+	std::string out;
+	out.reserve(len);
+	for (size_t i = 0; i < len; i++) {
+		uint32_t c = str[i];
+		if (c >= 0xD800 && c < 0xDC00 && i + 1 < len && str[i + 1] >= 0xDC00 && str[i + 1] < 0xE000) {
+			c = 0x10000 + ((c - 0xD800) << 10) + (str[i + 1] - 0xDC00);
+			i++;
+		}
+		if (c < 0x80) {
+			out += (char)c;
+		} else if (c < 0x800) {
+			out += (char)(0xC0 | (c >> 6));
+			out += (char)(0x80 | (c & 0x3F));
+		} else if (c < 0x10000) {
+			out += (char)(0xE0 | (c >> 12));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		} else {
+			out += (char)(0xF0 | (c >> 18));
+			out += (char)(0x80 | ((c >> 12) & 0x3F));
+			out += (char)(0x80 | ((c >> 6) & 0x3F));
+			out += (char)(0x80 | (c & 0x3F));
+		}
+	}
+	return out;
+}
+
+std::string ReadFString(long addr DRIVER_PROFILE_LOC)
+{
+	std::vector<char16_t> chars;
+	if (!ReadTArray(addr, chars, UE_MAX_STRING_LEN DRIVER_PROFILE_ARG))
+		return "";
+	size_t len = 0;
+	while (len < chars.size() && chars[len] != 0)
+		len++;
+	return Utf16ToUtf8(chars.data(), len);
+}
+
+// 读取 FUObjectArray::ObjObjects 中所有对象指针，每个块一次读取
+// item_size 为 FUObjectItem 大小，不同版本为 0x18 或 0x20 等
+bool ReadObjectArray(long addr, std::vector<uintptr_t> &objects, size_t item_size = 0x18 DRIVER_PROFILE_LOC)
+{
+	struct {
+		uintptr_t objects;
+		uintptr_t pre_allocated;
+		int32_t max_elements;
+		int32_t num_elements;
+		int32_t max_chunks;
+		int32_t num_chunks;
+	} header;
+
+	objects.clear();
+	if (!driver->read(addr, &header, sizeof(header) DRIVER_PROFILE_ARG))
+		return false;
+	if (header.num_elements < 0 || header.num_elements > UE_MAX_OBJECTS
+	|| header.num_chunks < 0 || (size_t)header.num_chunks > UE_MAX_OBJECTS / UE_OBJECT_CHUNK + 1)
+		return false;
+
+	std::vector<uintptr_t> chunks(header.num_chunks);
+	if (header.num_chunks > 0 && !driver->read(header.objects & 0xFFFFFFFFFFFF, chunks.data(), chunks.size() * sizeof(uintptr_t) DRIVER_PROFILE_ARG))
+		return false;
+
+	std::vector<uint8_t> items(UE_OBJECT_CHUNK * item_size);
+	objects.reserve(header.num_elements);
+	for (int32_t c = 0; c < header.num_chunks; c++) {
+		size_t count = std::min<size_t>(UE_OBJECT_CHUNK, header.num_elements - objects.size());
+		std::fill(items.begin(), items.begin() + count * item_size, 0);
+		if (chunks[c] != 0)
+			driver->read(chunks[c] & 0xFFFFFFFFFFFF, items.data(), count * item_size DRIVER_PROFILE_ARG);
+		for (size_t i = 0; i < count; i++) {
+			uintptr_t object;
+			memcpy(&object, items.data() + i * item_size, sizeof(object));
+			objects.push_back(object & 0xFFFFFFFFFFFF);
+		}
+		if (objects.size() >= (size_t)header.num_elements)
+			break;
+	}
+	return true;
+}
+
+// FNamePool(UE4.23+) 名称缓存，按名称 ID 缓存字符串
+// 名称池只追加不删除，已解析的名称始终有效；解析失败的 ID 在名称池增长时重新尝试
+class c_fname_cache {
+	public:
+	uintptr_t pool = 0;
+	uint32_t current_block_offset = 0x38;	// FNameEntryAllocator::CurrentBlock，其后为 CurrentByteCursor
+	uint32_t blocks_offset = 0x40;			// FNameEntryAllocator::Blocks
+	uint32_t stride = 2;
+	uint32_t len_shift = 6;
+	size_t max_length = 1024;
+
+	private:
+	std::mutex lock;
+	std::unordered_map<int32_t, std::string> names;
+	std::unordered_set<int32_t> misses;
+	std::vector<uintptr_t> blocks;
+	uint32_t current_block = 0;
+	uint32_t current_cursor = 0;
+
+	// 名称池有变化时返回 true
+	bool refresh(DRIVER_PROFILE_LOC_ONLY) {
+		uint32_t state[2] = {0, 0};
+		if (!driver->read(pool + current_block_offset, state, sizeof(state) DRIVER_PROFILE_ARG))
+			return false;
+		if (state[0] == current_block && state[1] == current_cursor && !blocks.empty())
+			return false;
+		if (state[0] > 0x2000)
+			return false;
+		if (state[0] < current_block || (state[0] == current_block && state[1] < current_cursor)) {
+			names.clear();
+		}
+		misses.clear();
+		current_block = state[0];
+		current_cursor = state[1];
+		blocks.assign(current_block + 1, 0);
+		driver->read(pool + blocks_offset, blocks.data(), blocks.size() * sizeof(uintptr_t) DRIVER_PROFILE_ARG);
+		for (auto &b : blocks)
+			b &= 0xFFFFFFFFFFFF;
+		return true;
+	}
+
+	bool resolve(int32_t id, std::string &out DRIVER_PROFILE_LOC) {
+		uint32_t block = (uint32_t)id >> 16;
+		uint32_t offset = ((uint32_t)id & 0xFFFF) * stride;
+		if (block >= blocks.size() || blocks[block] == 0)
+			return false;
+
+		// 大部分名称较短，名称头和字符串一次读取
+		uint8_t buf[2 + 128];
+		uintptr_t entry = blocks[block] + offset;
+		memset(buf, 0, sizeof(buf));
+		driver->read(entry, buf, sizeof(buf) DRIVER_PROFILE_ARG);
+		uint16_t header;
+		memcpy(&header, buf, sizeof(header));
+		bool wide = header & 1;
+		size_t len = header >> len_shift;
+		size_t bytes = len * (wide ? 2 : 1);
+		if (len == 0 || len > max_length)
+			return false;
+
+		std::vector<uint8_t> data(buf + 2, buf + 2 + std::min(bytes, sizeof(buf) - 2));
+		if (bytes > sizeof(buf) - 2) {
+			data.resize(bytes);
+			if (!driver->read(entry + 2, data.data(), bytes DRIVER_PROFILE_ARG))
+				return false;
+		}
+		if (wide) {
+			std::vector<char16_t> chars(len);
+			memcpy(chars.data(), data.data(), bytes);
+			out = Utf16ToUtf8(chars.data(), len);
+		} else {
+			out.assign((const char *)data.data(), len);
+		}
+		return true;
+	}
+
+	public:
+	c_fname_cache(uintptr_t pool = 0) : pool(pool) {
+	}
+
+	void clear() {
+		std::lock_guard<std::mutex> lk(lock);
+		names.clear();
+		misses.clear();
+		blocks.clear();
+		current_block = current_cursor = 0;
+	}
+
+	std::string get(int32_t id DRIVER_PROFILE_LOC) {
+		std::lock_guard<std::mutex> lk(lock);
+		auto it = names.find(id);
+		if (it != names.end())
+			return it->second;
+		if (misses.count(id) && !refresh(DRIVER_PROFILE_ARG_ONLY))
+			return "";
+		if (blocks.empty() || ((uint32_t)id >> 16) >= blocks.size())
+			refresh(DRIVER_PROFILE_ARG_ONLY);
+
+		std::string name;
+		if (!resolve(id, name DRIVER_PROFILE_ARG)) {
+			misses.insert(id);
+			return "";
+		}
+		names[id] = name;
+		return name;
+	}
+
+	std::string get(const FNameValue &name DRIVER_PROFILE_LOC) {
+		std::string str = get(name.index DRIVER_PROFILE_ARG);
+		if (name.number > 0)
+			str += "_" + std::to_string(name.number - 1);
+		return str;
+	}
+
+	std::string read(long addr DRIVER_PROFILE_LOC) {
+		FNameValue name;
+		if (!driver->read(addr, &name, sizeof(name) DRIVER_PROFILE_ARG))
+			return "";
+		return get(name DRIVER_PROFILE_ARG);
+	}
+};
+
+
+/*--------------------------------------------------------------------------------------------------------*/
+
+// 按帧合并读取：enqueue 登记读取并返回句柄，flush 时按地址排序，
+// 合并重叠、重复或间隔不超过 merge_gap 的范围，实际读取后分发到各自的目标缓冲区
+// 合并在一起的读取共享同一个成功状态，因此合并范围不跨页，避免一页不可读时连累另一页上的读取；
+// 句柄在 flush 之后下一次 enqueue 之前有效
+class c_read_planner {
+	public:
+	typedef size_t handle;
+
+	struct stats {
+		size_t requested;
+		size_t issued;
+		size_t merged;		// 因合并省去的读取次数(requested - issued)
+		size_t duplicates;	// 其中地址和长度完全相同的读取
+	};
+
+	size_t merge_gap = 64;
+	size_t max_span = 0x1000;
+
+	private:
+	struct request {
+		uintptr_t addr;
+		size_t size;
+		void *dst;
+		bool ok;
+#ifdef DRIVER_PROFILE
+		std::source_location loc;	// 合并读取记在排序后第一条请求的登记位置
+#endif
+	};
+
+	std::vector<request> requests;
+	std::vector<size_t> order;
+	std::vector<uint8_t> scratch;
+	stats last = {0, 0, 0, 0};
+	bool flushed = false;
+
+	public:
+	handle enqueue(uintptr_t addr, void *dst, size_t size DRIVER_PROFILE_LOC) {
+		if (flushed) {
+			requests.clear();
+			flushed = false;
+		}
+		request r = {addr, size, dst, false};
+#ifdef DRIVER_PROFILE
+		r.loc = loc;
+#endif
+		requests.push_back(r);
+		return requests.size() - 1;
+	}
+
+	template <typename T>
+	handle enqueue(uintptr_t addr, T *dst DRIVER_PROFILE_LOC) {
+		return enqueue(addr, dst, sizeof(T) DRIVER_PROFILE_ARG);
+	}
+
+	bool ok(handle h) const {
+		return h < requests.size() && requests[h].ok;
+	}
+
+	size_t pending() const {
+		return flushed ? 0 : requests.size();
+	}
+
+	stats last_stats() const {
+		return last;
+	}
+
+	stats flush() {
+		stats st = {requests.size(), 0, 0, 0};
+		if (flushed || requests.empty()) {
+			flushed = true;
+			last = {0, 0, 0, 0};
+			return last;
+		}
+
+		order.resize(requests.size());
+		for (size_t i = 0; i < order.size(); i++)
+			order[i] = i;
+		std::sort(order.begin(), order.end(), [this](size_t a, size_t b) {
+			if (requests[a].addr != requests[b].addr)
+				return requests[a].addr < requests[b].addr;
+			return requests[a].size > requests[b].size;
+		});
+
+		size_t i = 0;
+		while (i < order.size()) {
+			const request &head = requests[order[i]];
+			uintptr_t start = head.addr;
+			uintptr_t end = head.addr + head.size;
+			size_t j = i + 1;
+			for (; j < order.size(); j++) {
+				const request &r = requests[order[j]];
+				const request &prev = requests[order[j - 1]];
+				if (r.addr > end + merge_gap)
+					break;
+				uintptr_t new_end = std::max<uintptr_t>(end, r.addr + r.size);
+				if (new_end - start > max_span)
+					break;
+				if ((start & ~(uintptr_t)0xFFF) != ((new_end - 1) & ~(uintptr_t)0xFFF))
+					break;
+				if (r.addr == prev.addr && r.size == prev.size)
+					st.duplicates++;
+				end = new_end;
+			}
+
+			scratch.assign(end - start, 0);
+#ifdef DRIVER_PROFILE
+			const std::source_location &loc = head.loc;
+#endif
+			bool ok = driver->read(start, scratch.data(), scratch.size() DRIVER_PROFILE_ARG);
+			st.issued++;
+			for (size_t k = i; k < j; k++) {
+				request &r = requests[order[k]];
+				memcpy(r.dst, scratch.data() + (r.addr - start), r.size);
+				r.ok = ok;
+			}
+			i = j;
+		}
+		st.merged = st.requested - st.issued;
+		flushed = true;
+		last = st;
+		return st;
+	}
+};
@@ -4,7 +4,14 @@
 #include <linux/mm.h>
 #include <linux/slab.h>
 #include <linux/uaccess.h>
+#include <linux/uio.h>
+#include <linux/highmem.h>
+#include <linux/workqueue.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/moduleparam.h>
 #include <linux/version.h>
+#include <linux/hugetlb.h>
 #if(LINUX_VERSION_CODE >= KERNEL_VERSION(4,14,83))
 #include <linux/sched/mm.h>
 #endif
@@ -94,6 +101,232 @@ phys_addr_t translate_linear_address(struct mm_struct* mm, uintptr_t va) {
 }
 #endif
 
+#ifndef pmd_leaf
+#define pmd_leaf(pmd) pmd_huge(pmd)
+#endif
+#ifndef pud_leaf
+#define pud_leaf(pud) pud_huge(pud)
+#endif
+
+uint8_t pte_attributes(pte_t pte) {
+	uint8_t attr = PAGE_ATTR_PRESENT;
+
+	if (pte_none(pte)) {
+		return 0;
+	}
+	if (!pte_present(pte)) {
+		return PAGE_ATTR_SWAPPED;
+	}
+	if (pte_write(pte)) {
+		attr |= PAGE_ATTR_WRITE;
+	}
+	if (pte_dirty(pte)) {
+		attr |= PAGE_ATTR_DIRTY;
+	}
+	return attr;
+}
+
+//一次遍历整个范围的页表，空的上级页表和大页整段填充，每页输出一字节属性
+void query_page_attributes(struct mm_struct* mm, uintptr_t addr, size_t pages, uint8_t* out)
+{
+	uintptr_t end = addr + pages * PAGE_SIZE;
+	uintptr_t next;
+	uint8_t attr;
+	size_t n;
+	pgd_t *pgd;
+#if(LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 61))
+	p4d_t *p4d;
+#endif
+	pud_t *pud;
+	pmd_t *pmd;
+	pte_t *pte;
+
+	while (addr < end) {
+		attr = 0;
+		pgd = pgd_offset(mm, addr);
+		next = pgd_addr_end(addr, end);
+		if (pgd_none(*pgd) || pgd_bad(*pgd)) {
+			goto fill;
+		}
+#if(LINUX_VERSION_CODE >= KERNEL_VERSION(5, 4, 61))
+		p4d = p4d_offset(pgd, addr);
+		next = p4d_addr_end(addr, end);
+		if (p4d_none(*p4d) || p4d_bad(*p4d)) {
+			goto fill;
+		}
+		pud = pud_offset(p4d, addr);
+#else
+		pud = pud_offset(pgd, addr);
+#endif
+		next = pud_addr_end(addr, end);
+		if (pud_none(*pud)) {
+			goto fill;
+		}
+		if (pud_leaf(*pud)) {
+			attr = PAGE_ATTR_PRESENT | PAGE_ATTR_HUGE_PUD;
+			if (pud_write(*pud)) {
+				attr |= PAGE_ATTR_WRITE;
+			}
+			goto fill;
+		}
+		if (pud_bad(*pud)) {
+			goto fill;
+		}
+		pmd = pmd_offset(pud, addr);
+		next = pmd_addr_end(addr, end);
+		if (pmd_none(*pmd)) {
+			goto fill;
+		}
+		if (pmd_leaf(*pmd)) {
+			attr = PAGE_ATTR_PRESENT | PAGE_ATTR_HUGE_PMD;
+			if (pmd_write(*pmd)) {
+				attr |= PAGE_ATTR_WRITE;
+			}
+			if (pmd_dirty(*pmd)) {
+				attr |= PAGE_ATTR_DIRTY;
+			}
+			goto fill;
+		}
+		if (pmd_bad(*pmd)) {
+			goto fill;
+		}
+		pte = pte_offset_kernel(pmd, addr);
+		for (; addr < next; addr += PAGE_SIZE, pte++) {
+			*out++ = pte_attributes(*pte);
+		}
+		continue;
+	fill:
+		n = (next - addr) >> PAGE_SHIFT;
+		memset(out, attr, n);
+		out += n;
+		addr = next;
+	}
+}
+
+bool query_process_pages(PQUERY_PAGES qp)
+{
+	struct task_struct* task;
+	struct mm_struct* mm;
+	uintptr_t start = qp->addr & PAGE_MASK;
+	size_t pages;
+	uint8_t* out;
+	bool ok;
+
+	if (qp->size == 0 || qp->addr + qp->size < qp->addr) {
+		return false;
+	}
+	pages = (PAGE_ALIGN(qp->addr + qp->size) - start) >> PAGE_SHIFT;
+	if (pages > QUERY_MAX_PAGES) {
+		return false;
+	}
+	task = pid_task(find_vpid(qp->pid), PIDTYPE_PID);
+	if (!task) {
+		return false;
+	}
+	mm = get_task_mm(task);
+	if (!mm) {
+		return false;
+	}
+	out = kvmalloc(pages, GFP_KERNEL);
+	if (!out) {
+		mmput(mm);
+		return false;
+	}
+	query_page_attributes(mm, start, pages, out);
+	mmput(mm);
+	ok = copy_to_user((void __user*)qp->buffer, out, pages) == 0;
+	kvfree(out);
+	return ok;
+}
+
+struct translate_cache {
+	uintptr_t va;
+	phys_addr_t pa;
+};
+
+//同一页内的连续访问复用上一次的页表遍历结果
+phys_addr_t translate_linear_address_cached(struct mm_struct* mm, uintptr_t va, struct translate_cache* cache) {
+	uintptr_t page = va & PAGE_MASK;
+
+	if (cache && cache->pa && cache->va == page) {
+		return cache->pa + (va & (PAGE_SIZE-1));
+	}
+	phys_addr_t pa = translate_linear_address(mm, page);
+	if (cache) {
+		cache->va = page;
+		cache->pa = pa;
+	}
+	return pa ? pa + (va & (PAGE_SIZE-1)) : 0;
+}
+
+size_t read_physical_address_kernel(phys_addr_t pa, void* buffer, size_t size) {
+	void* mapped;
+
+	if (!pfn_valid(__phys_to_pfn(pa))) {
+		return 0;
+	}
+	mapped = ioremap_cache(pa, size);
+	if (!mapped) {
+		return 0;
+	}
+	memcpy(buffer, mapped, size);
+	iounmap(mapped);
+	return size;
+}
+
+//读取到内核缓冲区，缺页部分保持原样并返回 false
+bool read_mm_memory(struct mm_struct* mm, uintptr_t addr, void* buffer, size_t size, struct translate_cache* cache)
+{
+	phys_addr_t pa;
+	size_t max;
+	bool ok = true;
+
+	while (size > 0) {
+		pa = translate_linear_address_cached(mm, addr, cache);
+		max = min(PAGE_SIZE - (addr & (PAGE_SIZE - 1)), size);
+		if (!pa || !read_physical_address_kernel(pa, buffer, max)) {
+			ok = false;
+		}
+		size -= max;
+		buffer += max;
+		addr += max;
+	}
+	return ok;
+}
+
+size_t write_physical_address_kernel(phys_addr_t pa, const void* buffer, size_t size) {
+	void* mapped;
+
+	if (!pfn_valid(__phys_to_pfn(pa))) {
+		return 0;
+	}
+	mapped = ioremap_cache(pa, size);
+	if (!mapped) {
+		return 0;
+	}
+	memcpy(mapped, buffer, size);
+	iounmap(mapped);
+	return size;
+}
+
+bool write_mm_memory(struct mm_struct* mm, uintptr_t addr, const void* buffer, size_t size, struct translate_cache* cache)
+{
+	phys_addr_t pa;
+	size_t max;
+	bool ok = true;
+
+	while (size > 0) {
+		pa = translate_linear_address_cached(mm, addr, cache);
+		max = min(PAGE_SIZE - (addr & (PAGE_SIZE - 1)), size);
+		if (!pa || !write_physical_address_kernel(pa, buffer, max)) {
+			ok = false;
+		}
+		size -= max;
+		buffer += max;
+		addr += max;
+	}
+	return ok;
+}
 
 size_t read_physical_address(phys_addr_t pa, void* buffer, size_t size) {
 	void* mapped;
@@ -132,6 +365,170 @@ size_t write_physical_address(phys_addr_t pa, void* buffer, size_t size) {
 	return size;
 }
 
+//超过阈值的读取按块分给多个 CPU 并行处理，调用线程处理第一块
+//驱动加载后会删除模块的 sysfs 目录，这两个参数只能在 insmod 时指定
+//large_read_workers 为 0 时按在线 CPU 数分块，1 关闭并行读取
+static unsigned int large_read_threshold = 0x100000;
+module_param(large_read_threshold, uint, 0444);
+static unsigned int large_read_workers = 0;
+module_param(large_read_workers, uint, 0444);
+#define LARGE_READ_MAX_WORKERS 16
+
+static unsigned int large_read_worker_count(void)
+{
+	unsigned int workers = large_read_workers ? large_read_workers : num_online_cpus();
+
+	return min(workers, (unsigned int)LARGE_READ_MAX_WORKERS);
+}
+
+struct large_read_chunk {
+	struct work_struct work;
+	struct mm_struct* mm;
+	struct page** pages;
+	size_t offset;          //在目标缓冲区页中的偏移
+	uintptr_t addr;
+	size_t size;
+	int last;               //最后一次物理读取的结果，-1 表示没有可读的页
+	atomic_t* remaining;
+	struct completion* done;
+};
+
+void copy_to_pages(struct page** pages, size_t offset, const void* src, size_t size)
+{
+	struct page* page;
+	void* dst;
+	size_t in;
+	size_t n;
+
+	while (size > 0) {
+		page = pages[offset >> PAGE_SHIFT];
+		in = offset & (PAGE_SIZE - 1);
+		n = min(PAGE_SIZE - in, size);
+		dst = kmap(page);
+		memcpy(dst + in, src, n);
+		kunmap(page);
+		offset += n;
+		src += n;
+		size -= n;
+	}
+}
+
+void large_read_chunk_run(struct large_read_chunk* c)
+{
+	uintptr_t addr = c->addr;
+	size_t offset = c->offset;
+	size_t size = c->size;
+	phys_addr_t pa;
+	void* mapped;
+	size_t max;
+
+	c->last = -1;
+	while (size > 0) {
+		pa = translate_linear_address(c->mm, addr);
+		max = min(PAGE_SIZE - (addr & (PAGE_SIZE - 1)), size);
+		if (pa) {
+			c->last = 0;
+			if (pfn_valid(__phys_to_pfn(pa))) {
+				mapped = ioremap_cache(pa, max);
+				if (mapped) {
+					copy_to_pages(c->pages, offset, mapped, max);
+					iounmap(mapped);
+					c->last = 1;
+				}
+			}
+		}
+		size -= max;
+		offset += max;
+		addr += max;
+	}
+}
+
+void large_read_work(struct work_struct* work)
+{
+	struct large_read_chunk* c = container_of(work, struct large_read_chunk, work);
+
+	large_read_chunk_run(c);
+	if (atomic_dec_and_test(c->remaining)) {
+		complete(c->done);
+	}
+}
+
+//固定目标缓冲区的页后由多个 CPU 直接写入，返回 -1 表示无法并行处理
+int read_process_memory_parallel(struct mm_struct* mm, uintptr_t addr, void* buffer, size_t size)
+{
+	struct large_read_chunk* chunks;
+	struct page** pages;
+	struct completion done;
+	atomic_t remaining;
+	uintptr_t ubuf = (uintptr_t)buffer;
+	size_t first = ubuf & (PAGE_SIZE - 1);
+	unsigned long nr_pages = (first + size + PAGE_SIZE - 1) >> PAGE_SHIFT;
+	unsigned int workers = large_read_worker_count();
+	size_t per;
+	unsigned long i;
+	unsigned int n;
+	int pinned = 0;
+	int ret = -1;
+
+	//get_user_pages_fast 的页数是 int，超出时交给逐页读取
+	if (size == 0 || workers < 2 || size >= ((size_t)INT_MAX << PAGE_SHIFT) || nr_pages > INT_MAX) {
+		return -1;
+	}
+	pages = kvmalloc_array(nr_pages, sizeof(struct page*), GFP_KERNEL);
+	if (!pages) {
+		return -1;
+	}
+	pinned = get_user_pages_fast(ubuf & PAGE_MASK, nr_pages, FOLL_WRITE, pages);
+	if (pinned != nr_pages) {
+		goto out_pages;
+	}
+	per = ALIGN(DIV_ROUND_UP(size, workers), PAGE_SIZE);
+	n = DIV_ROUND_UP(size, per);
+	chunks = kcalloc(n, sizeof(*chunks), GFP_KERNEL);
+	if (!chunks) {
+		goto out_pages;
+	}
+
+	init_completion(&done);
+	atomic_set(&remaining, n - 1);
+	for (i = 0; i < n; i++) {
+		chunks[i].mm = mm;
+		chunks[i].pages = pages;
+		chunks[i].offset = first + i * per;
+		chunks[i].addr = addr + i * per;
+		chunks[i].size = min(per, size - i * per);
+		chunks[i].remaining = &remaining;
+		chunks[i].done = &done;
+		if (i > 0) {
+			INIT_WORK(&chunks[i].work, large_read_work);
+			queue_work(system_unbound_wq, &chunks[i].work);
+		}
+	}
+	large_read_chunk_run(&chunks[0]);
+	if (n > 1) {
+		wait_for_completion(&done);
+	}
+
+	//与逐页读取一致：结果取最后一次物理读取
+	ret = 0;
+	for (i = n; i > 0; i--) {
+		if (chunks[i - 1].last >= 0) {
+			ret = chunks[i - 1].last;
+			break;
+		}
+	}
+	kfree(chunks);
+out_pages:
+	for (i = 0; i < (unsigned long)max(pinned, 0); i++) {
+		if (ret >= 0) {
+			set_page_dirty_lock(pages[i]);
+		}
+		put_page(pages[i]);
+	}
+	kvfree(pages);
+	return ret;
+}
+
 bool read_process_memory(pid_t pid, uintptr_t addr, void* buffer, size_t size)
 {
 	struct task_struct* task;
@@ -148,6 +545,13 @@ bool read_process_memory(pid_t pid, uintptr_t addr, void* buffer, size_t size)
 	if (!mm) {
 		return false;
 	}
+	if (size > 0 && size >= max_t(size_t, large_read_threshold, PAGE_SIZE) && large_read_worker_count() > 1) {
+		int ret = read_process_memory_parallel(mm, addr, buffer, size);
+		if (ret >= 0) {
+			mmput(mm);
+			return ret;
+		}
+	}
 	while (size > 0) {
 		pa = translate_linear_address(mm, addr);
 		max = min(PAGE_SIZE - (addr & (PAGE_SIZE - 1)), min(size, PAGE_SIZE));
@@ -196,3 +600,199 @@ bool write_process_memory(pid_t pid, uintptr_t addr, void* buffer, size_t size)
 	mmput(mm);
 	return count;
 }
+
+bool gather_process_memory(PGATHER_MEMORY gm)
+{
+	struct task_struct* task;
+	struct mm_struct* mm;
+	struct translate_cache cache = {0};
+	GATHER_FIELD* fields = NULL;
+	size_t field_base[GATHER_MAX_FIELDS];
+	uintptr_t* pointers = NULL;
+	uint8_t* out = NULL;
+	uint8_t* valid = NULL;
+	size_t total = 0;
+	size_t valid_size;
+	uintptr_t elem;
+	uint32_t i, f;
+	bool ok = false;
+
+	if (gm->count == 0 || gm->count > GATHER_MAX_COUNT
+	|| gm->field_count == 0 || gm->field_count > GATHER_MAX_FIELDS) {
+		return false;
+	}
+	fields = kmalloc_array(gm->field_count, sizeof(GATHER_FIELD), GFP_KERNEL);
+	if (!fields) {
+		return false;
+	}
+	if (copy_from_user(fields, (void __user*)gm->fields, gm->field_count * sizeof(GATHER_FIELD)) != 0) {
+		goto out_fields;
+	}
+	for (f = 0; f < gm->field_count; f++) {
+		if (fields[f].size == 0 || fields[f].size > PAGE_SIZE) {
+			goto out_fields;
+		}
+		field_base[f] = total;
+		total += (size_t)fields[f].size * gm->count;
+	}
+	if (total > GATHER_MAX_SIZE) {
+		goto out_fields;
+	}
+
+	task = pid_task(find_vpid(gm->pid), PIDTYPE_PID);
+	if (!task) {
+		goto out_fields;
+	}
+	mm = get_task_mm(task);
+	if (!mm) {
+		goto out_fields;
+	}
+
+	valid_size = (gm->count + 7) / 8;
+	out = kvzalloc(total, GFP_KERNEL);
+	valid = kzalloc(valid_size, GFP_KERNEL);
+	if (!out || !valid) {
+		goto out_mm;
+	}
+	if (gm->stride == 0) {
+		//指针数组一次性读入，读不到的元素为空指针
+		pointers = kvzalloc(gm->count * sizeof(uintptr_t), GFP_KERNEL);
+		if (!pointers) {
+			goto out_mm;
+		}
+		read_mm_memory(mm, gm->base, pointers, gm->count * sizeof(uintptr_t), &cache);
+	}
+
+	for (i = 0; i < gm->count; i++) {
+		bool elem_ok = true;
+
+		elem = pointers ? pointers[i] & 0xFFFFFFFFFFFF : gm->base + (uintptr_t)i * gm->stride;
+		if (!elem) {
+			continue;
+		}
+		for (f = 0; f < gm->field_count; f++) {
+			if (!read_mm_memory(mm, elem + fields[f].offset,
+				out + field_base[f] + (size_t)i * fields[f].size, fields[f].size, &cache)) {
+				elem_ok = false;
+			}
+		}
+		if (elem_ok) {
+			valid[i / 8] |= 1 << (i % 8);
+		}
+	}
+
+	ok = copy_to_user((void __user*)gm->buffer, out, total) == 0
+		&& copy_to_user((void __user*)gm->valid, valid, valid_size) == 0;
+
+out_mm:
+	kvfree(pointers);
+	kvfree(out);
+	kfree(valid);
+	mmput(mm);
+out_fields:
+	kfree(fields);
+	return ok;
+}
+
+//页在内核线性映射中才能 kmap；arm64 5.14 起 pfn_valid 对 nomap 预留区也为真，
+//这类内存(如驱动通过 remap_pfn_range 映射给进程的显存)只能走 ioremap
+static bool pfn_is_linear_mapped(unsigned long pfn)
+{
+#if defined(CONFIG_ARM64) && (LINUX_VERSION_CODE >= KERNEL_VERSION(5, 14, 0))
+	return pfn_valid(pfn) && pfn_is_map_memory(pfn);
+#else
+	return pfn_valid(pfn);
+#endif
+}
+
+//普通内存直接通过页映射读取，不经过 ioremap 和用户缓冲区，最多跨越两页
+bool read_process_small(PSMALL_MEMORY sm)
+{
+	struct task_struct* task;
+	struct mm_struct* mm;
+	uintptr_t addr = sm->addr;
+	size_t size = sm->size;
+	size_t done = 0;
+	size_t max;
+	phys_addr_t pa;
+	void* mapped;
+
+	sm->copied = 0;
+	if (size == 0 || size > SMALL_READ_MAX) {
+		return false;
+	}
+	task = pid_task(find_vpid(sm->pid), PIDTYPE_PID);
+	if (!task) {
+		return false;
+	}
+	mm = get_task_mm(task);
+	if (!mm) {
+		return false;
+	}
+	while (done < size) {
+		pa = translate_linear_address(mm, addr);
+		max = min(PAGE_SIZE - (addr & (PAGE_SIZE - 1)), size - done);
+		if (!pa) {
+			break;
+		}
+		if (pfn_is_linear_mapped(__phys_to_pfn(pa))) {
+			mapped = kmap_atomic(pfn_to_page(__phys_to_pfn(pa)));
+			memcpy(sm->value + done, mapped + (pa & (PAGE_SIZE - 1)), max);
+			kunmap_atomic(mapped);
+		} else if (!read_physical_address_kernel(pa, sm->value + done, max)) {
+			break;
+		}
+		done += max;
+		addr += max;
+	}
+	mmput(mm);
+	sm->copied = done;
+	return done == size;
+}
+
+//按 iov_iter 连续读写目标地址，遇到缺页时停止，返回已传输的字节数
+ssize_t process_memory_iter(pid_t pid, uintptr_t addr, struct iov_iter* iter, bool write)
+{
+	struct task_struct* task;
+	struct mm_struct* mm;
+	phys_addr_t pa;
+	void* mapped;
+	size_t max;
+	size_t n;
+	ssize_t done = 0;
+
+	if (iov_iter_count(iter) == 0) {
+		return 0;
+	}
+	task = pid_task(find_vpid(pid), PIDTYPE_PID);
+	if (!task) {
+		return -ESRCH;
+	}
+	mm = get_task_mm(task);
+	if (!mm) {
+		return -ESRCH;
+	}
+	while (iov_iter_count(iter) > 0) {
+		pa = translate_linear_address(mm, addr);
+		max = min(PAGE_SIZE - (addr & (PAGE_SIZE - 1)), iov_iter_count(iter));
+		if (!pa || !pfn_valid(__phys_to_pfn(pa))) {
+			break;
+		}
+		mapped = ioremap_cache(pa, max);
+		if (!mapped) {
+			break;
+		}
+		n = write ? copy_from_iter(mapped, max, iter) : copy_to_iter(mapped, max, iter);
+		iounmap(mapped);
+		done += n;
+		addr += n;
+		if (n < max) {
+			if (done == 0) {
+				done = -EFAULT;
+			}
+			break;
+		}
+	}
+	mmput(mm);
+	return done ? done : -EIO;
+}
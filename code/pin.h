@@ -0,0 +1,185 @@
+#include <linux/sched.h>
+#include <linux/pid.h>
+#include <linux/mutex.h>
+#include <linux/workqueue.h>
+#include <linux/jiffies.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+
+struct pin_slot {
+	struct pid* pid;
+	unsigned long next;
+	PIN_ENTRY entry;
+};
+
+static struct pin_slot pin_slots[PIN_MAX_ENTRIES];
+static int pin_count = 0;
+static DEFINE_MUTEX(pin_lock);
+
+static void pin_worker(struct work_struct* work);
+static DECLARE_DELAYED_WORK(pin_work, pin_worker);
+
+//移除 pid 的所有锁定，调用时需持有 pin_lock
+static void pin_remove_locked(struct pid* pid)
+{
+	int i, n = 0;
+
+	for (i = 0; i < pin_count; i++) {
+		if (pin_slots[i].pid == pid) {
+			put_pid(pin_slots[i].pid);
+			continue;
+		}
+		pin_slots[n++] = pin_slots[i];
+	}
+	pin_count = n;
+}
+
+//单个工作项按进程分组批量写入，同一进程只获取一次 mm，同一页只遍历一次页表
+static void pin_worker(struct work_struct* work)
+{
+	struct task_struct* task;
+	struct mm_struct* mm;
+	struct translate_cache cache;
+	unsigned long now = jiffies;
+	unsigned long next = now + HZ;
+	int i = 0, j;
+
+	mutex_lock(&pin_lock);
+	while (i < pin_count) {
+		struct pid* pid = pin_slots[i].pid;
+
+		mm = NULL;
+		rcu_read_lock();
+		task = pid_task(pid, PIDTYPE_PID);
+		if (task) {
+			mm = get_task_mm(task);
+		}
+		rcu_read_unlock();
+		if (!mm) {
+			//目标进程已退出
+			pin_remove_locked(pid);
+			continue;
+		}
+		memset(&cache, 0, sizeof(cache));
+		for (j = i; j < pin_count && pin_slots[j].pid == pid; j++) {
+			struct pin_slot* slot = &pin_slots[j];
+
+			if (time_after_eq(now, slot->next)) {
+				if (write_mm_memory(mm, slot->entry.addr, slot->entry.value, slot->entry.size, &cache)) {
+					slot->entry.hits++;
+				} else {
+					slot->entry.misses++;
+				}
+				slot->next = now + max(msecs_to_jiffies(slot->entry.interval_ms), 1UL);
+			}
+			if (time_before(slot->next, next)) {
+				next = slot->next;
+			}
+		}
+		mmput(mm);
+		i = j;
+	}
+	if (pin_count > 0) {
+		queue_delayed_work(system_wq, &pin_work, time_after(next, jiffies) ? next - jiffies : 1);
+	}
+	mutex_unlock(&pin_lock);
+}
+
+//替换 pid 的锁定列表，count 为 0 时清除
+bool pin_process_memory(PPIN_MEMORY pm)
+{
+	struct pid* pid;
+	PIN_ENTRY* entries = NULL;
+	uint32_t i, existing = 0;
+	bool ok = false;
+
+	if (pm->count > PIN_MAX_ENTRIES) {
+		return false;
+	}
+	if (pm->count) {
+		entries = kmalloc_array(pm->count, sizeof(PIN_ENTRY), GFP_KERNEL);
+		if (!entries) {
+			return false;
+		}
+		if (copy_from_user(entries, (void __user*)pm->entries, pm->count * sizeof(PIN_ENTRY)) != 0) {
+			goto out;
+		}
+		for (i = 0; i < pm->count; i++) {
+			if (entries[i].size == 0 || entries[i].size > PIN_MAX_VALUE) {
+				goto out;
+			}
+		}
+	}
+	pid = find_get_pid(pm->pid);
+	if (!pid) {
+		goto out;
+	}
+
+	mutex_lock(&pin_lock);
+	//先按替换后的数量检查容量，失败时保留原有锁定
+	for (i = 0; i < pin_count; i++) {
+		if (pin_slots[i].pid == pid) {
+			existing++;
+		}
+	}
+	if (pin_count - existing + pm->count <= PIN_MAX_ENTRIES) {
+		pin_remove_locked(pid);
+		for (i = 0; i < pm->count; i++) {
+			struct pin_slot* slot = &pin_slots[pin_count++];
+
+			slot->pid = get_pid(pid);
+			slot->next = jiffies;
+			slot->entry = entries[i];
+			slot->entry.hits = 0;
+			slot->entry.misses = 0;
+		}
+		ok = true;
+	}
+	if (pin_count > 0) {
+		mod_delayed_work(system_wq, &pin_work, 0);
+	}
+	mutex_unlock(&pin_lock);
+	put_pid(pid);
+out:
+	kfree(entries);
+	return ok;
+}
+
+//返回 pid 当前的锁定列表及命中统计，pm->count 输入为缓冲区容量，返回为锁定数量
+bool pin_process_stats(PPIN_MEMORY pm)
+{
+	struct pid* pid;
+	PIN_ENTRY* entries;
+	uint32_t n = 0;
+	int i;
+	bool ok;
+
+	entries = kmalloc_array(PIN_MAX_ENTRIES, sizeof(PIN_ENTRY), GFP_KERNEL);
+	if (!entries) {
+		return false;
+	}
+	pid = find_get_pid(pm->pid);
+	mutex_lock(&pin_lock);
+	for (i = 0; pid && i < pin_count; i++) {
+		if (pin_slots[i].pid == pid) {
+			entries[n++] = pin_slots[i].entry;
+		}
+	}
+	mutex_unlock(&pin_lock);
+	put_pid(pid);
+
+	ok = copy_to_user((void __user*)pm->entries, entries, min(n, pm->count) * sizeof(PIN_ENTRY)) == 0;
+	pm->count = n;
+	kfree(entries);
+	return ok;
+}
+
+void pin_release_all(void)
+{
+	cancel_delayed_work_sync(&pin_work);
+	mutex_lock(&pin_lock);
+	while (pin_count > 0) {
+		pin_remove_locked(pin_slots[0].pid);
+	}
+	mutex_unlock(&pin_lock);
+}
@@ -0,0 +1,223 @@
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#if(LINUX_VERSION_CODE >= KERNEL_VERSION(4,14,83))
+#include <linux/sched/signal.h>
+#endif
+
+//每执行这么多步让出一次 CPU 并检查致命信号
+#define PROGRAM_RESCHED_STEPS 1024
+
+//检查指令编码、寄存器编号、读取长度和跳转目标，通过后才允许执行
+bool verify_program(PPROGRAM_INSN insns, uint32_t count)
+{
+	uint32_t i;
+
+	if (count == 0 || count > PROGRAM_MAX_INSNS) {
+		return false;
+	}
+	for (i = 0; i < count; i++) {
+		PPROGRAM_INSN insn = &insns[i];
+
+		if (insn->op >= PROG_OP_MAX || insn->dst >= PROGRAM_REGS || insn->src >= PROGRAM_REGS) {
+			return false;
+		}
+		switch (insn->op) {
+			case PROG_READ:
+			case PROG_EMIT:
+				if (insn->size != 1 && insn->size != 2 && insn->size != 4 && insn->size != 8) {
+					return false;
+				}
+				break;
+			case PROG_EMITM:
+				if (insn->size == 0) {
+					return false;
+				}
+				break;
+			default:
+				break;
+		}
+		switch (insn->op) {
+			case PROG_JEQ:
+			case PROG_JNE:
+			case PROG_JLT:
+			case PROG_JGE:
+			case PROG_JEQI:
+			case PROG_JNEI:
+			case PROG_LOOP:
+				if (insn->target >= count) {
+					return false;
+				}
+				break;
+			case PROG_READ:
+			case PROG_DEREF:
+			case PROG_EMITM:
+				if (insn->target != PROG_NO_TARGET && insn->target >= count) {
+					return false;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+	return true;
+}
+
+bool run_program(PPROGRAM_MEMORY pm)
+{
+	struct task_struct* task;
+	struct mm_struct* mm;
+	struct translate_cache cache = {0};
+	PPROGRAM_INSN insns;
+	uint8_t* out = NULL;
+	uint64_t* r = pm->regs;
+	uint32_t out_size = min_t(uint32_t, pm->output_size, PROGRAM_MAX_OUTPUT);
+	uint32_t step_budget = min_t(uint32_t, pm->step_budget ? pm->step_budget : PROGRAM_MAX_STEPS, PROGRAM_MAX_STEPS);
+	uint32_t byte_budget = min_t(uint32_t, pm->byte_budget ? pm->byte_budget : PROGRAM_MAX_BYTES, PROGRAM_MAX_BYTES);
+	uint32_t pc = 0;
+	uint64_t value;
+	bool ok = false;
+
+	if (pm->insn_count == 0 || pm->insn_count > PROGRAM_MAX_INSNS) {
+		return false;
+	}
+	insns = kmalloc_array(pm->insn_count, sizeof(PROGRAM_INSN), GFP_KERNEL);
+	if (!insns) {
+		return false;
+	}
+	if (copy_from_user(insns, (void __user*)pm->insns, pm->insn_count * sizeof(PROGRAM_INSN)) != 0
+	|| !verify_program(insns, pm->insn_count)) {
+		goto out_insns;
+	}
+	task = pid_task(find_vpid(pm->pid), PIDTYPE_PID);
+	if (!task) {
+		goto out_insns;
+	}
+	mm = get_task_mm(task);
+	if (!mm) {
+		goto out_insns;
+	}
+	if (out_size) {
+		out = kvmalloc(out_size, GFP_KERNEL);
+		if (!out) {
+			goto out_mm;
+		}
+	}
+
+	pm->status = PROG_OK;
+	pm->output_used = 0;
+	pm->steps = 0;
+	pm->fault_pc = 0;
+	while (pc < pm->insn_count) {
+		PPROGRAM_INSN insn = &insns[pc];
+		uint32_t len;
+
+		if (pm->steps++ >= step_budget) {
+			pm->status = PROG_STEP_LIMIT;
+			break;
+		}
+		if (pm->steps % PROGRAM_RESCHED_STEPS == 0) {
+			if (fatal_signal_pending(current)) {
+				goto out_output;
+			}
+			cond_resched();
+		}
+		pc++;
+		switch (insn->op) {
+			case PROG_EXIT:
+				pc = pm->insn_count;
+				break;
+			case PROG_LDI:
+				r[insn->dst] = insn->imm;
+				break;
+			case PROG_MOV:
+				r[insn->dst] = r[insn->src];
+				break;
+			case PROG_ADD:
+				r[insn->dst] += r[insn->src] + insn->imm;
+				break;
+			case PROG_ADDI:
+				r[insn->dst] += insn->imm;
+				break;
+			case PROG_READ:
+			case PROG_DEREF:
+				len = insn->op == PROG_DEREF ? sizeof(uint64_t) : insn->size;
+				if (byte_budget < len) {
+					pm->status = PROG_BYTE_LIMIT;
+					goto done;
+				}
+				byte_budget -= len;
+				value = 0;
+				if (!read_mm_memory(mm, r[insn->src] + insn->imm, &value, len, &cache)) {
+					goto fault;
+				}
+				r[insn->dst] = insn->op == PROG_DEREF ? value & 0xFFFFFFFFFFFF : value;
+				break;
+			case PROG_JEQ:
+				if (r[insn->dst] == r[insn->src]) pc = insn->target;
+				break;
+			case PROG_JNE:
+				if (r[insn->dst] != r[insn->src]) pc = insn->target;
+				break;
+			case PROG_JLT:
+				if (r[insn->dst] < r[insn->src]) pc = insn->target;
+				break;
+			case PROG_JGE:
+				if (r[insn->dst] >= r[insn->src]) pc = insn->target;
+				break;
+			case PROG_JEQI:
+				if (r[insn->dst] == insn->imm) pc = insn->target;
+				break;
+			case PROG_JNEI:
+				if (r[insn->dst] != insn->imm) pc = insn->target;
+				break;
+			case PROG_LOOP:
+				if (r[insn->dst] != 0 && --r[insn->dst] != 0) pc = insn->target;
+				break;
+			case PROG_EMIT:
+				if (pm->output_used + insn->size > out_size) {
+					pm->status = PROG_OUTPUT_FULL;
+					goto done;
+				}
+				memcpy(out + pm->output_used, &r[insn->src], insn->size);
+				pm->output_used += insn->size;
+				break;
+			case PROG_EMITM:
+				len = insn->size;
+				if (pm->output_used + len > out_size) {
+					pm->status = PROG_OUTPUT_FULL;
+					goto done;
+				}
+				if (byte_budget < len) {
+					pm->status = PROG_BYTE_LIMIT;
+					goto done;
+				}
+				byte_budget -= len;
+				memset(out + pm->output_used, 0, len);
+				pm->output_used += len;
+				if (!read_mm_memory(mm, r[insn->src] + insn->imm, out + pm->output_used - len, len, &cache)) {
+					goto fault;
+				}
+				break;
+		}
+		continue;
+	fault:
+		//有异常处理目标时跳转，否则以 PROG_FAULT 结束
+		if (insn->target == PROG_NO_TARGET) {
+			pm->status = PROG_FAULT;
+			pm->fault_pc = pc - 1;
+			break;
+		}
+		pc = insn->target;
+	}
+done:
+	ok = out_size == 0 || copy_to_user((void __user*)pm->output, out, pm->output_used) == 0;
+out_output:
+	kvfree(out);
+out_mm:
+	mmput(mm);
+out_insns:
+	kfree(insns);
+	return ok;
+}
@@ -0,0 +1,136 @@
+#include <linux/sched.h>
+#include <linux/hrtimer.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/version.h>
+#if(LINUX_VERSION_CODE >= KERNEL_VERSION(4,14,83))
+#include <linux/sched/signal.h>
+#endif
+
+#define WATCH_DEFAULT_INTERVAL_US 200
+#define WATCH_MIN_INTERVAL_US 20
+
+//读取所有监视值，进程已退出时返回 false
+bool watch_sample(pid_t pid, PWATCH_ENTRY entries, uint32_t count, uint64_t* values, bool* readable)
+{
+	struct task_struct* task;
+	struct mm_struct* mm;
+	struct translate_cache cache = {0};
+	uint32_t i;
+
+	task = pid_task(find_vpid(pid), PIDTYPE_PID);
+	if (!task) {
+		return false;
+	}
+	mm = get_task_mm(task);
+	if (!mm) {
+		return false;
+	}
+	for (i = 0; i < count; i++) {
+		values[i] = 0;
+		readable[i] = read_mm_memory(mm, entries[i].addr, &values[i], entries[i].size, &cache);
+	}
+	mmput(mm);
+	return true;
+}
+
+bool watch_test(PWATCH_ENTRY entry, uint64_t initial, uint64_t value)
+{
+	switch (entry->condition) {
+		case WATCH_CHANGED:
+			return value != initial;
+		case WATCH_EQUAL:
+			return value == entry->value;
+		case WATCH_NOT_EQUAL:
+			return value != entry->value;
+		case WATCH_GREATER:
+			return value > entry->value;
+		case WATCH_LESS:
+			return value < entry->value;
+		default:
+			return false;
+	}
+}
+
+//在内核中按间隔采样并睡眠，直到某个条目满足条件、超时、进程退出或收到信号
+//成功(含超时)返回 0，收到信号返回 -EINTR，其他失败返回 -1
+int wait_process_memory(PWAIT_MEMORY wm)
+{
+	PWATCH_ENTRY entries;
+	uint64_t* initial;
+	uint64_t* values;
+	bool* readable;
+	bool* baseline;
+	ktime_t deadline;
+	ktime_t interval;
+	uint32_t i;
+	int ret = -1;
+
+	if (wm->count == 0 || wm->count > WATCH_MAX_ENTRIES) {
+		return -1;
+	}
+	entries = kmalloc_array(wm->count, sizeof(WATCH_ENTRY), GFP_KERNEL);
+	initial = kmalloc_array(wm->count, sizeof(uint64_t) * 2 + sizeof(bool) * 2, GFP_KERNEL);
+	if (!entries || !initial) {
+		goto out;
+	}
+	values = initial + wm->count;
+	readable = (bool*)(values + wm->count);
+	baseline = readable + wm->count;
+	if (copy_from_user(entries, (void __user*)wm->entries, wm->count * sizeof(WATCH_ENTRY)) != 0) {
+		goto out;
+	}
+	for (i = 0; i < wm->count; i++) {
+		if (entries[i].size == 0 || entries[i].size > sizeof(uint64_t)) {
+			goto out;
+		}
+	}
+
+	interval = ns_to_ktime((u64)max_t(uint32_t, wm->interval_us ? wm->interval_us : WATCH_DEFAULT_INTERVAL_US,
+		WATCH_MIN_INTERVAL_US) * NSEC_PER_USEC);
+	deadline = ktime_add_ms(ktime_get(), wm->timeout_ms);
+	wm->hit = -1;
+
+	if (!watch_sample(wm->pid, entries, wm->count, initial, readable)) {
+		goto out;
+	}
+	memcpy(values, initial, wm->count * sizeof(uint64_t));
+	memcpy(baseline, readable, wm->count * sizeof(bool));
+	for (;;) {
+		for (i = 0; i < wm->count; i++) {
+			//开始时不可读的条目以第一次读到的值作为 WATCH_CHANGED 的初始值
+			if (readable[i] && !baseline[i]) {
+				initial[i] = values[i];
+				baseline[i] = true;
+			}
+			if (readable[i] && watch_test(&entries[i], initial[i], values[i])) {
+				wm->hit = i;
+				break;
+			}
+		}
+		if (wm->hit >= 0 || ktime_after(ktime_get(), deadline)) {
+			break;
+		}
+		if (signal_pending(current)) {
+			ret = -EINTR;
+			goto out;
+		}
+		set_current_state(TASK_INTERRUPTIBLE);
+		schedule_hrtimeout_range(&interval, ktime_to_ns(interval) / 4, HRTIMER_MODE_REL);
+		if (!watch_sample(wm->pid, entries, wm->count, values, readable)) {
+			goto out;
+		}
+	}
+
+	for (i = 0; i < wm->count; i++) {
+		entries[i].value = values[i];
+	}
+	if (copy_to_user((void __user*)wm->entries, entries, wm->count * sizeof(WATCH_ENTRY)) == 0) {
+		ret = 0;
+	}
+out:
+	kfree(initial);
+	kfree(entries);
+	return ret;
+}